@@ -0,0 +1,601 @@
+/*
+ * Copyright (c) 2015, Lakshman Anumolu, Pradeep Garigipati
+ * All rights reserved.
+ *
+ * This file is part of MeshIO whose distribution is governed by
+ * the BSD 2-Clause License contained in the accompanying LICENSE.txt
+ * file.
+ */
+
+/*
+ * meshio-convert: converts STL files between ASCII and binary encodings.
+ *
+ * Facets are streamed from input to output in fixed size batches, so memory
+ * usage per worker thread is bounded irrespective of the mesh size. Multiple
+ * files (or whole directories) are converted concurrently, one file per
+ * worker thread.
+ *
+ * Usage: meshio-convert [options] <input>...
+ *   -o <path>   Output file (single input) or output directory
+ *   -t <fmt>    Target format, "ascii" or "binary". Defaults to the
+ *               opposite of each input's format
+ *   -j <N>      Number of worker threads (default: hardware concurrency)
+ *   -r          Recurse into sub directories of directory inputs
+ *   -q          Only print the summary
+ */
+
+#include <meshio/stl.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using meshio::stl::Format;
+
+namespace {
+
+/* Number of facets buffered before a flush to the output stream */
+constexpr std::size_t BATCH_FACETS = 4096;
+
+/* Size of a single facet record in binary STL: normal, 3 vertices, attrib */
+constexpr std::size_t FACET_SIZE = 12 * sizeof(float) + sizeof(uint16_t);
+
+constexpr std::size_t HEADER_SIZE = 80;
+
+struct Job {
+    fs::path mInput;
+    fs::path mOutput;
+};
+
+/* Suffixes given to outputs written next to their inputs */
+const char* const ASCII_SUFFIX  = ".ascii.stl";
+const char* const BINARY_SUFFIX = ".binary.stl";
+
+struct Stats {
+    uint64_t    mBytesIn   = 0;
+    uint64_t    mBytesOut  = 0;
+    uint64_t    mTriangles = 0;
+    double      mSeconds   = 0.0;
+    std::string mError;
+};
+
+/*
+ * Walks the triangle counts of a binary STL file, one per object as
+ * stl::read expects them. Returns true and the total number of triangles
+ * if the counts exactly account for the file size.
+ */
+bool binaryLayout(const fs::path& pFileName, uint64_t& pTriangles)
+{
+    std::error_code ec;
+    const uint64_t fileSize = fs::file_size(pFileName, ec);
+    if (ec || fileSize < HEADER_SIZE + sizeof(uint32_t))
+        return false;
+
+    std::ifstream ifs(pFileName, std::ios::binary);
+    uint64_t offset = HEADER_SIZE;
+    uint64_t triangles = 0;
+    while (offset + sizeof(uint32_t) <= fileSize) {
+        uint32_t numTriangles = 0;
+        ifs.seekg(offset);
+        if (!ifs.read((char *)&numTriangles, sizeof(uint32_t)))
+            return false;
+        offset += sizeof(uint32_t) + uint64_t(numTriangles) * FACET_SIZE;
+        triangles += numTriangles;
+        /* A zero count terminates the object list */
+        if (!numTriangles)
+            break;
+    }
+    pTriangles = triangles;
+
+    return offset == fileSize;
+}
+
+/*
+ * Files starting with "solid" are ASCII unless their size is exactly
+ * accounted for by binary facet records; some CAD exporters begin binary
+ * headers with "solid" as well.
+ */
+Format detectFormat(const fs::path& pFileName)
+{
+    std::ifstream ifs(pFileName, std::ios::binary);
+    char magic[5] = {0};
+    ifs.read(&magic[0], 5);
+    if (std::strncmp(&magic[0], "solid", 5) != 0)
+        return Format::Binary;
+
+    uint64_t triangles = 0;
+    return binaryLayout(pFileName, triangles) && triangles ? Format::Binary
+                                                           : Format::Ascii;
+}
+
+/* Number of facets in an ASCII STL file, counted by their endloop lines */
+uint64_t countAsciiTriangles(const fs::path& pFileName)
+{
+    std::ifstream ifs(pFileName);
+    std::string line;
+    uint64_t triangles = 0;
+    while (std::getline(ifs, line)) {
+        const std::size_t first = line.find_first_not_of(" \t");
+        if (first != std::string::npos &&
+            line.compare(first, 7, "endloop") == 0)
+            ++triangles;
+    }
+    return triangles;
+}
+
+/* Parses pCount whitespace separated floats starting at pStr */
+const char* parseFloats(const char* pStr, float* pOut, int pCount)
+{
+    char* end = nullptr;
+    for (int i = 0; i < pCount; ++i) {
+        pOut[i] = std::strtof(pStr, &end);
+        pStr = end;
+    }
+    return pStr;
+}
+
+const char* skipToken(const char* pStr)
+{
+    while (*pStr == ' ' || *pStr == '\t')
+        ++pStr;
+    while (*pStr && *pStr != ' ' && *pStr != '\t')
+        ++pStr;
+    return pStr;
+}
+
+bool startsWith(const char* pStr, const char* pKey)
+{
+    return std::strncmp(pStr, pKey, std::strlen(pKey)) == 0;
+}
+
+/*
+ * Streams ASCII STL to binary STL. Every solid becomes one object in the
+ * output; its triangle count is patched in once endsolid is seen, which is
+ * the layout stl::read expects for multi-object binary files.
+ */
+bool asciiToBinary(const fs::path& pIn, const fs::path& pOut, Stats& pStats)
+{
+    std::ifstream ifs(pIn);
+    if (!ifs) {
+        pStats.mError = "cannot open input";
+        return false;
+    }
+    std::ofstream ofs(pOut, std::ios::binary | std::ios::out);
+    if (!ofs) {
+        pStats.mError = "cannot open output";
+        return false;
+    }
+
+    char header[HEADER_SIZE] = {0};
+    std::strncpy(&header[0], "Binary STL file written using MeshIO",
+                 HEADER_SIZE - 1);
+    ofs.write(&header[0], HEADER_SIZE);
+
+    std::vector<char> batch;
+    batch.reserve(BATCH_FACETS * FACET_SIZE);
+
+    auto flush = [&]() {
+        ofs.write(batch.data(), batch.size());
+        batch.clear();
+    };
+
+    std::string line;
+    std::streampos countPos = -1;
+    uint32_t numTriangles = 0;
+    float record[12] = {0};
+    int vertexCount = 0;
+    const uint16_t attribByteCount = 0;
+
+    /* Patches the triangle count of the current solid, if any. A zero
+       count ends the object list of a binary file, so an empty solid is
+       dropped by rewinding over its count instead */
+    auto endSolid = [&]() {
+        if (countPos == std::streampos(-1))
+            return;
+        flush();
+        if (numTriangles) {
+            const std::streampos endPos = ofs.tellp();
+            ofs.seekp(countPos);
+            ofs.write((char *)&numTriangles, sizeof(uint32_t));
+            ofs.seekp(endPos);
+            pStats.mTriangles += numTriangles;
+        } else {
+            ofs.seekp(countPos);
+        }
+        countPos = -1;
+    };
+
+    while (std::getline(ifs, line)) {
+        const char* str = line.c_str();
+        while (*str == ' ' || *str == '\t')
+            ++str;
+
+        if (startsWith(str, "vertex")) {
+            if (vertexCount < 3)
+                parseFloats(skipToken(str), &record[3 + 3 * vertexCount], 3);
+            ++vertexCount;
+        } else if (startsWith(str, "facet")) {
+            /* skip "facet normal" */
+            parseFloats(skipToken(skipToken(str)), &record[0], 3);
+        } else if (startsWith(str, "outer")) {
+            vertexCount = 0;
+        } else if (startsWith(str, "endloop")) {
+            const char* bytes = reinterpret_cast<const char*>(&record[0]);
+            batch.insert(batch.end(), bytes, bytes + 12 * sizeof(float));
+            bytes = reinterpret_cast<const char*>(&attribByteCount);
+            batch.insert(batch.end(), bytes, bytes + sizeof(uint16_t));
+            ++numTriangles;
+            if (batch.size() >= BATCH_FACETS * FACET_SIZE)
+                flush();
+        } else if (startsWith(str, "endsolid")) {
+            endSolid();
+        } else if (startsWith(str, "solid")) {
+            endSolid();
+            countPos = ofs.tellp();
+            numTriangles = 0;
+            ofs.write((char *)&numTriangles, sizeof(uint32_t));
+        }
+    }
+    /* Tolerate files that end without an endsolid, as stl::read does */
+    endSolid();
+
+    const std::streamoff outSize = ofs.tellp();
+    ofs.close();
+
+    if (!pStats.mTriangles) {
+        pStats.mError = "no facets found";
+        return false;
+    }
+
+    /* Cut off the count of a trailing empty solid */
+    std::error_code ec;
+    fs::resize_file(pOut, static_cast<uint64_t>(outSize), ec);
+
+    return !ofs.fail() && !ec;
+}
+
+/*
+ * Streams binary STL to ASCII STL, BATCH_FACETS facets at a time. Output text
+ * matches what stl::write emits for Format::Ascii.
+ */
+bool binaryToAscii(const fs::path& pIn, const fs::path& pOut, Stats& pStats)
+{
+    std::ifstream ifs(pIn, std::ios::binary | std::ios::in);
+    if (!ifs) {
+        pStats.mError = "cannot open input";
+        return false;
+    }
+    std::ofstream ofs(pOut);
+    if (!ofs) {
+        pStats.mError = "cannot open output";
+        return false;
+    }
+
+    char header[HEADER_SIZE];
+    ifs.read(&header[0], HEADER_SIZE);
+
+    std::vector<char> records(BATCH_FACETS * FACET_SIZE);
+    std::string text;
+    text.reserve(BATCH_FACETS * 320);
+    char buffer[128];
+
+    auto appendTriple = [&](const char* pPrefix, const float* pValues) {
+        int n = std::snprintf(&buffer[0], sizeof(buffer), "%s%e %e %e\n",
+                              pPrefix, pValues[0], pValues[1], pValues[2]);
+        text.append(&buffer[0], n);
+    };
+
+    uint32_t numTriangles = 0;
+    while (ifs.read((char *)&numTriangles, sizeof(uint32_t)) && numTriangles) {
+        ofs << "solid \n";
+
+        uint32_t remaining = numTriangles;
+        while (remaining) {
+            const uint32_t count =
+                std::min<uint32_t>(remaining, static_cast<uint32_t>(BATCH_FACETS));
+            if (!ifs.read(records.data(), count * FACET_SIZE))
+                return false;
+
+            for (uint32_t facet = 0; facet < count; ++facet) {
+                float values[12];
+                std::memcpy(&values[0], &records[facet * FACET_SIZE],
+                            sizeof(values));
+                appendTriple("facet normal ", &values[0]);
+                text.append("outer loop\n");
+                appendTriple("vertex ", &values[3]);
+                appendTriple("vertex ", &values[6]);
+                appendTriple("vertex ", &values[9]);
+                text.append("endloop\nendfacet\n");
+            }
+            ofs.write(text.data(), text.size());
+            text.clear();
+            remaining -= count;
+        }
+
+        ofs << "endsolid\n";
+        pStats.mTriangles += numTriangles;
+        numTriangles = 0;
+    }
+
+    return static_cast<bool>(ofs);
+}
+
+/* Same-format copy when the input is already in the target encoding */
+bool copyFile(const fs::path& pIn, const fs::path& pOut, const Format pFormat,
+              Stats& pStats)
+{
+    if (pFormat == Format::Binary)
+        binaryLayout(pIn, pStats.mTriangles);
+    else
+        pStats.mTriangles = countAsciiTriangles(pIn);
+
+    std::error_code ec;
+    fs::copy_file(pIn, pOut, fs::copy_options::overwrite_existing, ec);
+    if (ec)
+        pStats.mError = ec.message();
+    return !ec;
+}
+
+bool convert(const Job& pJob, const bool pHasTarget, const Format pTarget,
+             Stats& pStats)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    /* Opening the output would truncate the input before it is read */
+    std::error_code ec;
+    if (fs::equivalent(pJob.mInput, pJob.mOutput, ec)) {
+        pStats.mError = "output is the same file as the input";
+        return false;
+    }
+
+    const Format source = detectFormat(pJob.mInput);
+    const Format target = pHasTarget ? pTarget
+                        : (source == Format::Ascii ? Format::Binary
+                                                   : Format::Ascii);
+    bool status = false;
+    if (source == target)
+        status = copyFile(pJob.mInput, pJob.mOutput, source, pStats);
+    else if (source == Format::Ascii)
+        status = asciiToBinary(pJob.mInput, pJob.mOutput, pStats);
+    else
+        status = binaryToAscii(pJob.mInput, pJob.mOutput, pStats);
+
+    pStats.mBytesIn = fs::file_size(pJob.mInput, ec);
+    pStats.mBytesOut = status ? fs::file_size(pJob.mOutput, ec) : 0;
+    pStats.mSeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+    return status;
+}
+
+bool isSTL(const fs::path& pFileName)
+{
+    std::string ext = pFileName.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return ext == ".stl";
+}
+
+bool endsWith(const std::string& pStr, const std::string& pSuffix)
+{
+    return pStr.size() >= pSuffix.size() &&
+           pStr.compare(pStr.size() - pSuffix.size(), pSuffix.size(),
+                        pSuffix) == 0;
+}
+
+/* Whether pFileName looks like an output of an earlier run without -o */
+bool isDefaultOutput(const fs::path& pFileName)
+{
+    const std::string name = pFileName.filename().string();
+    return endsWith(name, ASCII_SUFFIX) || endsWith(name, BINARY_SUFFIX);
+}
+
+fs::path defaultOutput(const fs::path& pInput, const bool pHasTarget,
+                       const Format pTarget)
+{
+    Format target = pTarget;
+    if (!pHasTarget)
+        target = detectFormat(pInput) == Format::Ascii ? Format::Binary
+                                                       : Format::Ascii;
+    fs::path out = pInput;
+    out.replace_extension(target == Format::Ascii ? ASCII_SUFFIX
+                                                  : BINARY_SUFFIX);
+    return out;
+}
+
+double toMiB(const uint64_t pBytes)
+{
+    return pBytes / (1024.0 * 1024.0);
+}
+
+void usage(const char* pProgram)
+{
+    std::cerr
+        << "Usage: " << pProgram << " [options] <input>...\n"
+        << "  -o <path>  output file (single input) or output directory\n"
+        << "  -t <fmt>   target format: ascii | binary"
+        << " (default: opposite of input)\n"
+        << "  -j <N>     number of worker threads\n"
+        << "  -r         recurse into sub directories\n"
+        << "  -q         only print the summary\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<fs::path> inputs;
+    fs::path output;
+    bool hasTarget = false;
+    Format target = Format::Binary;
+    unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+    bool recursive = false;
+    bool quiet = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "-o" && hasValue) {
+            output = argv[++i];
+        } else if (arg == "-t" && hasValue) {
+            const std::string fmt = argv[++i];
+            hasTarget = true;
+            if (fmt == "ascii") {
+                target = Format::Ascii;
+            } else if (fmt == "binary") {
+                target = Format::Binary;
+            } else {
+                std::cerr << "Unknown format (" << fmt << ")" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "-j" && hasValue) {
+            numThreads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-r") {
+            recursive = true;
+        } else if (arg == "-q") {
+            quiet = true;
+        } else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            inputs.emplace_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* Expand directories into the list of STL files they contain */
+    std::vector<Job> jobs;
+    bool batchMode = inputs.size() > 1;
+    for (const fs::path& input : inputs) {
+        std::error_code ec;
+        if (fs::is_directory(input, ec)) {
+            batchMode = true;
+            /* Without -o, outputs land next to the inputs; never pick
+               those up again on a later run over the same directory */
+            auto addEntry = [&](const fs::directory_entry& pEntry) {
+                if (pEntry.is_regular_file() && isSTL(pEntry.path()) &&
+                    !(output.empty() && isDefaultOutput(pEntry.path())))
+                    jobs.push_back({pEntry.path(),
+                                    fs::relative(pEntry.path(), input)});
+            };
+            if (recursive) {
+                for (const auto& entry : fs::recursive_directory_iterator(input))
+                    addEntry(entry);
+            } else {
+                for (const auto& entry : fs::directory_iterator(input))
+                    addEntry(entry);
+            }
+        } else if (fs::is_regular_file(input, ec)) {
+            jobs.push_back({input, input.filename()});
+        } else {
+            std::cerr << "Cannot open file (" << input.string() << ")"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* A single input may be written into an existing directory as well */
+    std::error_code ec;
+    const bool outputIsDirectory = batchMode || fs::is_directory(output, ec);
+
+    for (Job& job : jobs) {
+        if (output.empty()) {
+            job.mOutput = defaultOutput(job.mInput, hasTarget, target);
+        } else if (outputIsDirectory) {
+            job.mOutput = output / job.mOutput;
+            fs::create_directories(job.mOutput.parent_path(), ec);
+        } else {
+            job.mOutput = output;
+        }
+    }
+
+    numThreads = std::min<unsigned>(numThreads,
+                                    std::max<std::size_t>(1, jobs.size()));
+
+    std::vector<Stats> stats(jobs.size());
+    std::vector<char> status(jobs.size(), 0);
+    std::atomic<std::size_t> nextJob(0);
+    std::mutex printMutex;
+
+    auto worker = [&]() {
+        for (std::size_t j = nextJob++; j < jobs.size(); j = nextJob++) {
+            status[j] = convert(jobs[j], hasTarget, target, stats[j]);
+            if (quiet && status[j])
+                continue;
+
+            std::lock_guard<std::mutex> lock(printMutex);
+            if (!status[j]) {
+                std::cerr << "Failed to convert (" << jobs[j].mInput.string()
+                          << ")";
+                if (!stats[j].mError.empty())
+                    std::cerr << ": " << stats[j].mError;
+                std::cerr << std::endl;
+                continue;
+            }
+            const Stats& s = stats[j];
+            std::printf("%s -> %s: %llu triangles, %.2f MiB in %.3f s"
+                        " (%.2f MiB/s)\n",
+                        jobs[j].mInput.string().c_str(),
+                        jobs[j].mOutput.string().c_str(),
+                        (unsigned long long)s.mTriangles, toMiB(s.mBytesIn),
+                        s.mSeconds,
+                        s.mSeconds > 0 ? toMiB(s.mBytesIn) / s.mSeconds : 0.0);
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < numThreads; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& t : threads)
+        t.join();
+
+    const double wallSeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+    Stats total;
+    std::size_t failures = 0;
+    for (std::size_t j = 0; j < jobs.size(); ++j) {
+        if (!status[j]) {
+            ++failures;
+            continue;
+        }
+        total.mBytesIn   += stats[j].mBytesIn;
+        total.mBytesOut  += stats[j].mBytesOut;
+        total.mTriangles += stats[j].mTriangles;
+    }
+
+    std::printf("Converted %zu/%zu files using %u threads in %.3f s\n",
+                jobs.size() - failures, jobs.size(), numThreads, wallSeconds);
+    std::printf("  %llu triangles, %.2f MiB read, %.2f MiB written\n",
+                (unsigned long long)total.mTriangles, toMiB(total.mBytesIn),
+                toMiB(total.mBytesOut));
+    if (wallSeconds > 0)
+        std::printf("  %.2f MiB/s, %.2f Mtriangles/s\n",
+                    toMiB(total.mBytesIn) / wallSeconds,
+                    total.mTriangles / wallSeconds * 1e-6);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -9,9 +9,88 @@
 
 namespace internal {
 
-template<typename T = float>
-void readAsciiSTL(std::vector< meshio::stl::Data<T> > &pObjects,
-                  const char* pFileName)
+/* Size in bytes of one binary STL facet: normal, 3 vertices, attribute */
+constexpr std::size_t BINARY_FACET_SIZE = 12 * sizeof(float) + sizeof(uint16_t);
+
+/* Number of facets decoded/encoded per block of binary file I/O */
+constexpr std::size_t BINARY_BLOCK_FACETS = 4096;
+
+static_assert(sizeof(Vec3<float>) == 3 * sizeof(float),
+              "Vec3<float> must be tightly packed");
+static_assert(sizeof(Vec4<float>) == 4 * sizeof(float),
+              "Vec4<float> must be tightly packed");
+
+/*
+ * Converts between binary STL facet records and Data<T> storage. The on disk
+ * layout is always IEEE single precision, hence T=float copies the x, y, z
+ * fields straight out of/into the record while any other T widens/narrows
+ * through a fixed size float block the compiler can vectorize. The choice is
+ * made at compile time; no per element branching remains in the loops.
+ */
+template<typename T>
+struct BinaryFacetCodec {
+    static void decode(const char* pSrc, std::size_t pCount,
+                       Vec3<float>* pNormals, Vec4<T>* pPositions)
+    {
+        for (std::size_t facet = 0; facet < pCount; ++facet) {
+            const char* record = pSrc + facet * BINARY_FACET_SIZE;
+            std::memcpy(&pNormals[facet].x, record, 3 * sizeof(float));
+
+            Vec4<T>* positions = pPositions + 3 * facet;
+            if constexpr (std::is_same<T, float>::value) {
+                for (int i = 0; i < 3; ++i) {
+                    std::memcpy(&positions[i].x,
+                                record + (3 + 3 * i) * sizeof(float),
+                                3 * sizeof(float));
+                    positions[i].w = 1.0f;
+                }
+            } else {
+                float values[9];
+                std::memcpy(&values[0], record + 3 * sizeof(float),
+                            sizeof(values));
+                for (int i = 0; i < 3; ++i)
+                    positions[i] = Vec4<T>(static_cast<T>(values[3 * i + 0]),
+                                           static_cast<T>(values[3 * i + 1]),
+                                           static_cast<T>(values[3 * i + 2]),
+                                           static_cast<T>(1));
+            }
+        }
+    }
+
+    static void encode(const Vec3<float>* pNormals, const Vec4<T>* pPositions,
+                       std::size_t pCount, char* pDst)
+    {
+        for (std::size_t facet = 0; facet < pCount; ++facet) {
+            char* record = pDst + facet * BINARY_FACET_SIZE;
+            std::memcpy(record, &pNormals[facet].x, 3 * sizeof(float));
+
+            const Vec4<T>* positions = pPositions + 3 * facet;
+            if constexpr (std::is_same<T, float>::value) {
+                for (int i = 0; i < 3; ++i)
+                    std::memcpy(record + (3 + 3 * i) * sizeof(float),
+                                &positions[i].x, 3 * sizeof(float));
+            } else {
+                float values[9];
+                for (int i = 0; i < 3; ++i) {
+                    values[3 * i + 0] = static_cast<float>(positions[i].x);
+                    values[3 * i + 1] = static_cast<float>(positions[i].y);
+                    values[3 * i + 2] = static_cast<float>(positions[i].z);
+                }
+                std::memcpy(record + 3 * sizeof(float), &values[0],
+                            sizeof(values));
+            }
+            std::memset(record + 12 * sizeof(float), 0, sizeof(uint16_t));
+        }
+    }
+};
+
+/*
+ * Walks an ASCII STL file and reports its contents to pVisitor, which has
+ * beginSolid(), normal(const Vec3<float>&), vertex(const Vec4<T>&) and
+ * endSolid() members. Only a single line is held at any time.
+ */
+template<typename T, typename Visitor>
+void scanAsciiSTL(const char* pFileName, Visitor& pVisitor)
 {
     auto readNormal = [](const std::string& pLine) -> Vec3<float> {
         Vec3<float> N;
@@ -21,12 +100,12 @@ void readAsciiSTL(std::vector< meshio::stl::Data<T> > &pObjects,
         return N;
     };
 
-    auto readVertex = [](const std::string& pLine) -> Vec4<float> {
-        Vec4<float> V;
+    auto readVertex = [](const std::string& pLine) -> Vec4<T> {
+        Vec4<T> V;
         std::stringstream lineSS(pLine);
         std::string vertex;
         lineSS >> vertex >> V.x >> V.y >> V.z;
-        V.w = 1.0;
+        V.w = (T)1.;
         return V;
     };
 
@@ -42,7 +121,8 @@ void readAsciiSTL(std::vector< meshio::stl::Data<T> > &pObjects,
         lineSS >> keyWord;
 
         if (keyWord == "solid") {
-            meshio::stl::Data<T> currObj;
+            pVisitor.beginSolid();
+            Vec3<float> lastNormal;
             bool isFacetRead = false;
             unsigned outerCount = 0;
 
@@ -55,7 +135,8 @@ void readAsciiSTL(std::vector< meshio::stl::Data<T> > &pObjects,
                     break;
 
                 if (key == "facet") {
-                    currObj.mNormals.push_back(readNormal(line));
+                    lastNormal = readNormal(line);
+                    pVisitor.normal(lastNormal);
                     isFacetRead = true;
                 } else if (key == "outer") {
                     /* Check if already facet is being read
@@ -64,7 +145,7 @@ void readAsciiSTL(std::vector< meshio::stl::Data<T> > &pObjects,
                        the normal
                      */
                     if (isFacetRead && outerCount > 1)
-                        currObj.mNormals.push_back(currObj.mNormals.back());
+                        pVisitor.normal(lastNormal);
                     /* No need to do anything else specific just
                     just proceed to next line to read vertices */
                     outerCount++;
@@ -78,15 +159,49 @@ void readAsciiSTL(std::vector< meshio::stl::Data<T> > &pObjects,
                     outerCount = 0;
                 }
                 else if (key == "vertex") {
-                    currObj.mPositions.push_back(readVertex(line));
+                    pVisitor.vertex(readVertex(line));
                 }
             }
-            pObjects.push_back(currObj);
+            pVisitor.endSolid();
         }
     }
     stlFile.close();
 }
 
+/*
+ * Parses an ASCII STL file, handing every solid to pOnObject as soon as its
+ * endsolid is read so that callers can consume objects one at a time.
+ */
+template<typename T, typename Func>
+void parseAsciiSTL(const char* pFileName, Func pOnObject)
+{
+    struct ObjectBuilder {
+        meshio::stl::Data<T> mObject;
+        Func&                mOnObject;
+
+        void beginSolid() { mObject = meshio::stl::Data<T>(); }
+        void normal(const Vec3<float>& pNormal) {
+            mObject.mNormals.push_back(pNormal);
+        }
+        void vertex(const Vec4<T>& pPosition) {
+            mObject.mPositions.push_back(pPosition);
+        }
+        void endSolid() { mOnObject(mObject); }
+    };
+
+    ObjectBuilder builder{meshio::stl::Data<T>(), pOnObject};
+    scanAsciiSTL<T>(pFileName, builder);
+}
+
+template<typename T = float>
+void readAsciiSTL(std::vector< meshio::stl::Data<T> > &pObjects,
+                  const char* pFileName)
+{
+    parseAsciiSTL<T>(pFileName, [&pObjects](meshio::stl::Data<T>& pObject) {
+        pObjects.push_back(pObject);
+    });
+}
+
 /*
  * Reads binary STL file assuming the format as described in
  * https://en.wikipedia.org/wiki/STL_(file_format). After the end of first
@@ -100,15 +215,9 @@ template<typename T = float>
 void readBinarySTL(std::vector< meshio::stl::Data<T> > &pObjects,
                    const char* pFileName)
 {
-    uint32_t numTriangles;
-    uint16_t attribByteCount;
-    float value;
-    std::vector<float> values;
-    std::size_t sizeFloat = sizeof(float);
-    std::size_t sizeUInt16 = sizeof(uint16_t);
-    unsigned objectCount = 0;
+    uint32_t numTriangles = 0;
+    std::vector<char> block(BINARY_BLOCK_FACETS * BINARY_FACET_SIZE);
 
-    std::stringstream strErr;
     std::ifstream ifs(pFileName, std::ios::binary | std::ios::in);
 
     char header[80];
@@ -116,41 +225,20 @@ void readBinarySTL(std::vector< meshio::stl::Data<T> > &pObjects,
 
     ifs.read((char *)&numTriangles, sizeof(uint32_t));
 
-    while (numTriangles) {
+    while (ifs && numTriangles) {
         meshio::stl::Data<T> stlObject;
         stlObject.resize(numTriangles);
-        Vec4<T> position;
-        Vec3<float> normal;
 
-        // Default assignment
-        position.w = (T)1.;
-
-        for (uint32_t facet = 0; facet < numTriangles; ++facet) {
-            values.clear();
-            for (short i = 0; i < 3; ++i) {
-                ifs.read((char *)&value, sizeFloat);
-                values.push_back(value);
-            }
-            normal.x = values[0];
-            normal.y = values[1];
-            normal.z = values[2];
-            stlObject.mNormals[facet] = normal;
-
-            for (short i = 0; i < 3; ++i) {
-                values.clear();
-                for (short j = 0; j < 3; ++j) {
-                    ifs.read((char *)&value, sizeFloat);
-                    values.push_back(value);
-                }
-                position.x = values[0];
-                position.y = values[1];
-                position.z = values[2];
-                stlObject.mPositions[(3 * facet) + i] = position;
-            }
-
-            ifs.read((char *)&attribByteCount, sizeUInt16);
+        for (uint32_t facet = 0; facet < numTriangles;) {
+            const std::size_t count =
+                std::min<std::size_t>(numTriangles - facet, BINARY_BLOCK_FACETS);
+            ifs.read(block.data(), count * BINARY_FACET_SIZE);
+            BinaryFacetCodec<T>::decode(block.data(), count,
+                                        &stlObject.mNormals[facet],
+                                        &stlObject.mPositions[3 * facet]);
+            facet += count;
         }
-        pObjects.push_back(stlObject);
+        pObjects.push_back(std::move(stlObject));
 
         numTriangles = 0;
         ifs.read((char *)&numTriangles, sizeof(uint32_t));
@@ -165,7 +253,7 @@ bool writeAsciiSTL(const char* pFileName,
 {
     using CSTLIter  = typename std::vector< meshio::stl::Data<T> >::const_iterator;
     using CVec3Iter = typename std::vector< Vec3<float> >::const_iterator;
-    using CVec4Iter = typename std::vector< Vec4<float> >::const_iterator;
+    using CVec4Iter = typename std::vector< Vec4<T> >::const_iterator;
 
     std::ofstream objFile(pFileName);
 
@@ -206,9 +294,6 @@ bool writeBinarySTL(const char* pFileName,
                     const std::vector< meshio::stl::Data<T> > &pObjects)
 {
     uint32_t numTriangles;
-    uint16_t attribByteCount = 0;
-    std::size_t sizeFloat = sizeof(float);
-    std::size_t sizeUInt16 = sizeof(uint16_t);
     unsigned objectCount = pObjects.size();
 
     std::stringstream strErr;
@@ -225,22 +310,21 @@ bool writeBinarySTL(const char* pFileName,
     const char *header = headerStr.c_str();
     ofs.write(header, 80);
 
+    std::vector<char> block(BINARY_BLOCK_FACETS * BINARY_FACET_SIZE);
+
     for (unsigned object = 0; object < objectCount; ++object) {
-        numTriangles = pObjects[object].mNormals.size();
+        const meshio::stl::Data<T>& stlObject = pObjects[object];
+        numTriangles = stlObject.mNormals.size();
         ofs.write((char *)&numTriangles, sizeof(uint32_t));
 
-        for (unsigned facet = 0; facet < numTriangles; ++facet) {
-            Vec3<float> normal = pObjects[object].mNormals[facet];
-            ofs.write((char *)&normal.x, sizeFloat);
-            ofs.write((char *)&normal.y, sizeFloat);
-            ofs.write((char *)&normal.z, sizeFloat);
-            for (short i = 0; i < 3; ++i) {
-                Vec4<T> position = pObjects[object].mPositions[3 * facet + i];
-                ofs.write((char *)&position.x, sizeFloat);
-                ofs.write((char *)&position.y, sizeFloat);
-                ofs.write((char *)&position.z, sizeFloat);
-            }
-            ofs.write((char *)&attribByteCount, sizeUInt16);
+        for (uint32_t facet = 0; facet < numTriangles;) {
+            const std::size_t count =
+                std::min<std::size_t>(numTriangles - facet, BINARY_BLOCK_FACETS);
+            BinaryFacetCodec<T>::encode(&stlObject.mNormals[facet],
+                                        &stlObject.mPositions[3 * facet],
+                                        count, block.data());
+            ofs.write(block.data(), count * BINARY_FACET_SIZE);
+            facet += count;
         }
     }
 
@@ -249,16 +333,9 @@ bool writeBinarySTL(const char* pFileName,
     return true;
 }
 
-}  // namespace internal
-
-template<typename T>
-bool read(std::vector< meshio::stl::Data<T> > &pObjects,
-          const char* pFileName)
+/* Reports an error and returns false if pFileName cannot be opened */
+inline bool detectFormat(const char* pFileName, meshio::stl::Format& pFormat)
 {
-    for (unsigned int i = 0; i < pObjects.size(); ++i)
-        pObjects[i].clear();
-    pObjects.clear();
-
     std::stringstream strErr;
     std::ifstream ifs(pFileName);
     if (!ifs) {
@@ -274,22 +351,69 @@ bool read(std::vector< meshio::stl::Data<T> > &pObjects,
     std::string line(&buffer[0]);
     ifs.close();
 
-    if (line.substr(0, 5) == "solid")
-        internal::readAsciiSTL<T>(pObjects, pFileName);
+    pFormat = line.substr(0, 5) == "solid" ? Format::Ascii : Format::Binary;
+
+    return true;
+}
+
+}  // namespace internal
+
+#include <meshio/details/stl_cache.inl>
+#include <meshio/details/stl_reorder.inl>
+#include <meshio/details/stl_indexed.inl>
+#include <meshio/details/stl_quantized.inl>
+
+template<typename T>
+bool read(std::vector< meshio::stl::Data<T> > &pObjects,
+          const char* pFileName,
+          const ReadOptions& pOptions)
+{
+    for (unsigned int i = 0; i < pObjects.size(); ++i)
+        pObjects[i].clear();
+    pObjects.clear();
+
+    Format format;
+    if (!internal::detectFormat(pFileName, format))
+        return false;
+
+    if (format == Format::Ascii) {
+        if (pOptions.mUseCache)
+            internal::readCachedAsciiSTL<T>(pObjects, pFileName, pOptions);
+        else
+            internal::readAsciiSTL<T>(pObjects, pFileName);
+    }
     else
         internal::readBinarySTL<T>(pObjects, pFileName);
 
+    for (meshio::stl::Data<T>& object : pObjects)
+        internal::spatialSort(object, pOptions.mSpatialOrder);
+
     return true;
 }
 
 template<typename T>
 bool write(const char* pFileName,
            const meshio::stl::Format pFormat,
-           const std::vector< meshio::stl::Data<T> > &pObjects)
+           const std::vector< meshio::stl::Data<T> > &pObjects,
+           const WriteOptions& pOptions)
 {
+    if (pOptions.mSpatialOrder != SpatialOrder::None) {
+        std::vector< meshio::stl::Data<T> > sortedObjects(pObjects);
+        for (meshio::stl::Data<T>& object : sortedObjects)
+            internal::spatialSort(object, pOptions.mSpatialOrder);
+        return write(pFileName, pFormat, sortedObjects);
+    }
+
     if(pFormat == Format::Ascii) {
         return internal::writeAsciiSTL(pFileName, pObjects);
     } else { //Binary STL
         return internal::writeBinarySTL(pFileName, pObjects);
     }
 }
+
+template<typename T>
+void spatialSort(meshio::stl::Data<T> &pObject, const SpatialOrder pOrder,
+                 const unsigned pNumThreads)
+{
+    internal::spatialSort(pObject, pOrder, pNumThreads);
+}
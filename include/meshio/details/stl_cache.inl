@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2015, Lakshman Anumolu, Pradeep Garigipati
+ * All rights reserved.
+ *
+ * This file is part of MeshIO whose distribution is governed by
+ * the BSD 2-Clause License contained in the accompanying LICENSE.txt
+ * file.
+ */
+
+namespace internal {
+
+/*
+ * Parsed mesh cache file layout. All sections start at CACHE_ALIGNMENT byte
+ * boundaries so that the file can be mapped and used in place.
+ *
+ *   CacheHeader
+ *   uint64_t normal and position counts of each object
+ *   per object: Vec3<float> normals, Vec4<T> positions
+ */
+constexpr char     CACHE_MAGIC[8]  = {'M', 'E', 'S', 'H', 'I', 'O', 'C', '\0'};
+constexpr uint32_t CACHE_VERSION   = 1;
+constexpr uint64_t CACHE_ALIGNMENT = 64;
+
+struct CacheHeader {
+    char     mMagic[8];
+    uint32_t mVersion;
+    uint32_t mScalarSize;
+    uint64_t mPathHash;
+    uint64_t mSourceSize;
+    int64_t  mSourceMTime;
+    uint64_t mContentHash;
+    uint64_t mObjectCount;
+    uint64_t mFileSize;
+};
+
+static_assert(sizeof(CacheHeader) == 64, "CacheHeader must be 64 bytes");
+
+inline uint64_t alignCacheOffset(uint64_t pOffset)
+{
+    return (pOffset + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+}
+
+/* 64-bit hash consuming eight bytes per step, used for change detection */
+inline uint64_t hashBytes(const char* pData, std::size_t pSize,
+                          uint64_t pSeed = 0xcbf29ce484222325ULL)
+{
+    const uint64_t prime = 0x100000001b3ULL;
+    const uint64_t mixer = 0x9e3779b97f4a7c15ULL;
+
+    uint64_t hash = pSeed;
+    std::size_t i = 0;
+    for (; i + sizeof(uint64_t) <= pSize; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, pData + i, sizeof(uint64_t));
+        hash = (hash ^ (word * mixer)) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; i < pSize; ++i)
+        hash = (hash ^ static_cast<unsigned char>(pData[i])) * prime;
+
+    return hash;
+}
+
+inline bool hashFile(const char* pFileName, uint64_t& pHash)
+{
+    std::ifstream ifs(pFileName, std::ios::binary | std::ios::in);
+    if (!ifs)
+        return false;
+
+    std::vector<char> block(1 << 20);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    while (ifs) {
+        ifs.read(block.data(), block.size());
+        hash = hashBytes(block.data(), ifs.gcount(), hash);
+    }
+    pHash = hash;
+
+    return true;
+}
+
+/* Fills in everything in pKey that identifies the source file, except the
+   content hash, which is only computed when needed */
+inline bool cacheKey(const char* pFileName, const ReadOptions& pOptions,
+                     const uint32_t pScalarSize, std::string& pCachePath,
+                     CacheHeader& pKey)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    const fs::path source = fs::absolute(pFileName, ec);
+    if (ec)
+        return false;
+
+    const uint64_t size = fs::file_size(source, ec);
+    if (ec)
+        return false;
+    const auto mtime = fs::last_write_time(source, ec);
+    if (ec)
+        return false;
+
+    const std::string sourceStr = source.string();
+
+    std::memset(&pKey, 0, sizeof(CacheHeader));
+    std::memcpy(&pKey.mMagic[0], &CACHE_MAGIC[0], sizeof(CACHE_MAGIC));
+    pKey.mVersion     = CACHE_VERSION;
+    pKey.mScalarSize  = pScalarSize;
+    pKey.mPathHash    = hashBytes(sourceStr.data(), sourceStr.size());
+    pKey.mSourceSize  = size;
+    pKey.mSourceMTime = static_cast<int64_t>(mtime.time_since_epoch().count());
+
+    /* Entries for different scalar types of the same source coexist */
+    const std::string suffix = "." + std::to_string(8 * pScalarSize) +
+                               ".mcache";
+    if (pOptions.mCacheDir.empty()) {
+        pCachePath = sourceStr + suffix;
+    } else {
+        std::stringstream name;
+        name << std::hex << pKey.mPathHash << suffix;
+        pCachePath = (fs::path(pOptions.mCacheDir) / name.str()).string();
+    }
+
+    return true;
+}
+
+template<typename T>
+bool loadCache(std::vector< meshio::stl::Data<T> > &pObjects,
+               const std::string& pCachePath, const bool pVerifyContent,
+               const CacheHeader& pKey)
+{
+    std::ifstream ifs(pCachePath, std::ios::binary | std::ios::in);
+    if (!ifs)
+        return false;
+
+    CacheHeader header;
+    if (!ifs.read((char *)&header, sizeof(CacheHeader)))
+        return false;
+
+    if (std::memcmp(&header.mMagic[0], &CACHE_MAGIC[0], sizeof(CACHE_MAGIC)) ||
+        header.mVersion     != pKey.mVersion     ||
+        header.mScalarSize  != pKey.mScalarSize  ||
+        header.mPathHash    != pKey.mPathHash    ||
+        header.mSourceSize  != pKey.mSourceSize  ||
+        header.mSourceMTime != pKey.mSourceMTime)
+        return false;
+
+    if (pVerifyContent && header.mContentHash != pKey.mContentHash)
+        return false;
+
+    std::error_code ec;
+    if (std::filesystem::file_size(pCachePath, ec) != header.mFileSize || ec ||
+        header.mObjectCount * 2 * sizeof(uint64_t) > header.mFileSize)
+        return false;
+
+    std::vector<uint64_t> counts(2 * header.mObjectCount);
+    ifs.read((char *)counts.data(), counts.size() * sizeof(uint64_t));
+    if (!ifs)
+        return false;
+
+    std::vector< meshio::stl::Data<T> > objects(header.mObjectCount);
+    uint64_t offset = sizeof(CacheHeader) + counts.size() * sizeof(uint64_t);
+    for (std::size_t i = 0; i < objects.size(); ++i) {
+        const uint64_t numNormals   = counts[2 * i];
+        const uint64_t numPositions = counts[2 * i + 1];
+        if (offset + numNormals * sizeof(Vec3<float>) +
+            numPositions * sizeof(Vec4<T>) > header.mFileSize)
+            return false;
+
+        objects[i].mNormals.resize(numNormals);
+        offset = alignCacheOffset(offset);
+        ifs.seekg(offset);
+        ifs.read((char *)objects[i].mNormals.data(),
+                 numNormals * sizeof(Vec3<float>));
+        offset += numNormals * sizeof(Vec3<float>);
+
+        objects[i].mPositions.resize(numPositions);
+        offset = alignCacheOffset(offset);
+        ifs.seekg(offset);
+        ifs.read((char *)objects[i].mPositions.data(),
+                 numPositions * sizeof(Vec4<T>));
+        offset += numPositions * sizeof(Vec4<T>);
+
+        if (!ifs)
+            return false;
+    }
+
+    if (offset != header.mFileSize)
+        return false;
+
+    pObjects.swap(objects);
+
+    return true;
+}
+
+/*
+ * Name for a cache writer's temporary file that is unique across threads and
+ * processes, including processes on other hosts sharing the cache directory.
+ * The random device, clock and thread id seeds are independent per writer.
+ */
+inline std::string cacheWriterId()
+{
+    std::random_device device;
+    std::mt19937_64 engine((uint64_t(device()) << 32) ^ device() ^
+        uint64_t(std::chrono::high_resolution_clock::now()
+                 .time_since_epoch().count()) ^
+        std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+    std::stringstream id;
+    id << std::hex << engine() << engine();
+    return id.str();
+}
+
+/*
+ * Writes pObjects to a temporary file which is then renamed over pCachePath,
+ * so concurrent readers never observe a partially written cache. Failing to
+ * write the cache is not an error for stl::read, hence nothing is reported.
+ */
+template<typename T>
+void storeCache(const std::vector< meshio::stl::Data<T> > &pObjects,
+                const std::string& pCachePath, CacheHeader pKey)
+{
+    namespace fs = std::filesystem;
+
+    std::stringstream tmpName;
+    tmpName << pCachePath << ".tmp." << cacheWriterId();
+    const std::string tmpPath = tmpName.str();
+
+    std::error_code ec;
+    const fs::path parent = fs::path(pCachePath).parent_path();
+    if (!parent.empty())
+        fs::create_directories(parent, ec);
+
+    {
+        std::ofstream ofs(tmpPath, std::ios::binary | std::ios::out);
+        if (!ofs)
+            return;
+
+        std::vector<uint64_t> counts(2 * pObjects.size());
+        for (std::size_t i = 0; i < pObjects.size(); ++i) {
+            counts[2 * i]     = pObjects[i].mNormals.size();
+            counts[2 * i + 1] = pObjects[i].mPositions.size();
+        }
+
+        uint64_t fileSize = sizeof(CacheHeader) +
+                            counts.size() * sizeof(uint64_t);
+        for (std::size_t i = 0; i < pObjects.size(); ++i) {
+            fileSize = alignCacheOffset(fileSize) +
+                       counts[2 * i] * sizeof(Vec3<float>);
+            fileSize = alignCacheOffset(fileSize) +
+                       counts[2 * i + 1] * sizeof(Vec4<T>);
+        }
+
+        pKey.mObjectCount = pObjects.size();
+        pKey.mFileSize    = fileSize;
+
+        ofs.write((char *)&pKey, sizeof(CacheHeader));
+        ofs.write((char *)counts.data(), counts.size() * sizeof(uint64_t));
+
+        const char padding[CACHE_ALIGNMENT] = {0};
+        auto pad = [&]() {
+            const uint64_t offset = ofs.tellp();
+            ofs.write(&padding[0], alignCacheOffset(offset) - offset);
+        };
+
+        for (const meshio::stl::Data<T>& object : pObjects) {
+            pad();
+            ofs.write((const char *)object.mNormals.data(),
+                      object.mNormals.size() * sizeof(Vec3<float>));
+            pad();
+            ofs.write((const char *)object.mPositions.data(),
+                      object.mPositions.size() * sizeof(Vec4<T>));
+        }
+
+        if (!ofs) {
+            ofs.close();
+            fs::remove(tmpPath, ec);
+            return;
+        }
+    }
+
+    fs::rename(tmpPath, pCachePath, ec);
+    if (ec)
+        fs::remove(tmpPath, ec);
+}
+
+/*
+ * Reads an ASCII STL file through the parsed mesh cache. A valid cache entry
+ * is loaded directly; a missing or stale one is rebuilt from the source.
+ */
+template<typename T = float>
+void readCachedAsciiSTL(std::vector< meshio::stl::Data<T> > &pObjects,
+                        const char* pFileName, const ReadOptions& pOptions)
+{
+    std::string cachePath;
+    CacheHeader key;
+    if (!cacheKey(pFileName, pOptions, sizeof(T), cachePath, key)) {
+        readAsciiSTL<T>(pObjects, pFileName);
+        return;
+    }
+
+    /* Without verification a hit costs only the cache read; the content
+       hash is then computed just before rebuilding a stale entry */
+    const bool verify = pOptions.mVerifyCacheContent;
+    if (verify)
+        hashFile(pFileName, key.mContentHash);
+
+    if (loadCache<T>(pObjects, cachePath, verify, key))
+        return;
+
+    if (!verify)
+        hashFile(pFileName, key.mContentHash);
+
+    readAsciiSTL<T>(pObjects, pFileName);
+    storeCache<T>(pObjects, cachePath, key);
+}
+
+}  // namespace internal
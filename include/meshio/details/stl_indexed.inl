@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2015, Lakshman Anumolu, Pradeep Garigipati
+ * All rights reserved.
+ *
+ * This file is part of MeshIO whose distribution is governed by
+ * the BSD 2-Clause License contained in the accompanying LICENSE.txt
+ * file.
+ */
+
+namespace internal {
+
+constexpr uint32_t INVALID_INDEX = ~0u;
+
+/* Adding +0 turns -0 into +0 and leaves every other value unchanged, so
+   that both zeros weld into one vertex */
+template<typename T>
+void weldKey(const Vec4<T>& pPosition, T (&pKey)[3])
+{
+    pKey[0] = pPosition.x + T(0);
+    pKey[1] = pPosition.y + T(0);
+    pKey[2] = pPosition.z + T(0);
+}
+
+template<typename T>
+uint64_t hashPosition(const Vec4<T>& pPosition)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    T key[3];
+    weldKey(pPosition, key);
+    hash = hashBytes((const char *)&key[0], sizeof(key), hash);
+    return hash ^ (hash >> 32);
+}
+
+template<typename T>
+bool samePosition(const Vec4<T>& pLhs, const Vec4<T>& pRhs)
+{
+    /* Bitwise, so that welding agrees with hashPosition */
+    T lhs[3], rhs[3];
+    weldKey(pLhs, lhs);
+    weldKey(pRhs, rhs);
+    return std::memcmp(&lhs[0], &rhs[0], sizeof(lhs)) == 0;
+}
+
+/*
+ * Vertex adjacency in compressed row form: the triangles using vertex v are
+ * mTriangles[mOffsets[v] .. mOffsets[v + 1]).
+ */
+struct VertexTriangles {
+    std::vector<uint32_t> mOffsets;
+    std::vector<uint32_t> mTriangles;
+
+    VertexTriangles(const std::vector<uint32_t>& pIndices,
+                    const std::size_t pNumVertices)
+        : mOffsets(pNumVertices + 1, 0), mTriangles(pIndices.size())
+    {
+        for (uint32_t index : pIndices)
+            ++mOffsets[index + 1];
+        for (std::size_t v = 0; v < pNumVertices; ++v)
+            mOffsets[v + 1] += mOffsets[v];
+
+        std::vector<uint32_t> cursor(mOffsets.begin(), mOffsets.end() - 1);
+        for (std::size_t i = 0; i < pIndices.size(); ++i)
+            mTriangles[cursor[pIndices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+};
+
+/*
+ * Triangle order from "Fast Triangle Reordering for Vertex Locality and
+ * Reduced Overdraw", Sander, Nehab and Barczak, SIGGRAPH 2007 (Tipsify).
+ * Runs in time linear in the number of triangles. pClusters receives the
+ * offsets into the order at which Tipsify restarts from a dead-end or an
+ * unvisited vertex, which are the hard cluster boundaries of its section 4.
+ */
+inline std::vector<uint32_t> tipsify(const std::vector<uint32_t>& pIndices,
+                                     const std::size_t pNumVertices,
+                                     const unsigned pCacheSize,
+                                     std::vector<uint32_t>& pClusters)
+{
+    const std::size_t numTriangles = pIndices.size() / 3;
+    const VertexTriangles adjacency(pIndices, pNumVertices);
+
+    std::vector<uint32_t> live(pNumVertices);
+    for (std::size_t v = 0; v < pNumVertices; ++v)
+        live[v] = adjacency.mOffsets[v + 1] - adjacency.mOffsets[v];
+
+    std::vector<uint32_t> cacheTime(pNumVertices, 0);
+    std::vector<char>     emitted(numTriangles, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> order;
+    order.reserve(numTriangles);
+    deadEnd.reserve(pIndices.size());
+
+    pClusters.assign(1, 0);
+
+    uint32_t time = pCacheSize + 1;
+    std::size_t cursor = 0;
+    int64_t fanning = pNumVertices ? 0 : -1;
+
+    while (fanning >= 0) {
+        candidates.clear();
+
+        const uint32_t f = static_cast<uint32_t>(fanning);
+        for (uint32_t a = adjacency.mOffsets[f];
+             a < adjacency.mOffsets[f + 1]; ++a) {
+            const uint32_t triangle = adjacency.mTriangles[a];
+            if (emitted[triangle])
+                continue;
+
+            for (int i = 0; i < 3; ++i) {
+                const uint32_t v = pIndices[3 * triangle + i];
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cacheTime[v] > pCacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[triangle] = 1;
+            order.push_back(triangle);
+        }
+
+        /* Prefer the candidate that stays in cache the longest once fanned */
+        fanning = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (!live[v])
+                continue;
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= pCacheSize)
+                priority = time - cacheTime[v];
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fanning = v;
+            }
+        }
+
+        if (fanning >= 0)
+            continue;
+
+        while (!deadEnd.empty()) {
+            const uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v]) {
+                fanning = v;
+                break;
+            }
+        }
+
+        while (fanning < 0 && cursor < pNumVertices) {
+            if (live[cursor])
+                fanning = static_cast<int64_t>(cursor);
+            ++cursor;
+        }
+
+        if (fanning >= 0 && order.size() > pClusters.back())
+            pClusters.push_back(static_cast<uint32_t>(order.size()));
+    }
+
+    return order;
+}
+
+/*
+ * Soft cluster boundaries (Tipsify, section 4.1): every cluster is replayed
+ * on a cache that starts empty and is cut right after the first triangle at
+ * which its own ACMR drops below pThreshold. Lower thresholds give fewer,
+ * larger clusters and so cost less vertex cache efficiency.
+ */
+inline std::vector<uint32_t> splitClusters(const std::vector<uint32_t>& pIndices,
+                                           const std::vector<uint32_t>& pOrder,
+                                           const std::vector<uint32_t>& pClusters,
+                                           const std::size_t pNumVertices,
+                                           const unsigned pCacheSize,
+                                           const float pThreshold)
+{
+    std::vector<uint32_t> clusters;
+    clusters.reserve(pClusters.size());
+
+    /* Same FIFO model as acmr(); a vertex loaded before the current cluster
+       started counts as a miss, which empties the cache between clusters */
+    std::vector<uint32_t> loadedAt(pNumVertices, INVALID_INDEX);
+    uint32_t misses = 0;
+
+    for (std::size_t c = 0; c < pClusters.size(); ++c) {
+        const std::size_t end = c + 1 < pClusters.size()
+                              ? pClusters[c + 1] : pOrder.size();
+        std::size_t start = pClusters[c];
+        uint32_t startMisses = misses;
+        clusters.push_back(static_cast<uint32_t>(start));
+
+        for (std::size_t t = start; t < end; ++t) {
+            for (int i = 0; i < 3; ++i) {
+                const uint32_t v = pIndices[3 * pOrder[t] + i];
+                const uint32_t stamp = loadedAt[v];
+                if (stamp == INVALID_INDEX || stamp < startMisses ||
+                    misses - stamp >= pCacheSize) {
+                    loadedAt[v] = misses;
+                    ++misses;
+                }
+            }
+
+            const float local = float(misses - startMisses) /
+                                float(t + 1 - start);
+            if (t + 1 < end && local < pThreshold) {
+                start = t + 1;
+                startMisses = misses;
+                clusters.push_back(static_cast<uint32_t>(start));
+            }
+        }
+    }
+
+    return clusters;
+}
+
+/*
+ * View independent overdraw order (Tipsify, section 4.2): clusters are drawn
+ * in decreasing order of dot(clusterCentroid - meshCentroid, clusterNormal),
+ * so that outward facing clusters on the hull, which tend to occlude the
+ * rest of the mesh from most viewpoints, are rasterized first. Centroids and
+ * normals are area weighted and taken from the triangle winding, which is
+ * what decides facing when rendering.
+ */
+template<typename T>
+std::vector<uint32_t> sortClusters(const std::vector< Vec4<T> >& pPositions,
+                                   const std::vector<uint32_t>& pIndices,
+                                   const std::vector<uint32_t>& pOrder,
+                                   const std::vector<uint32_t>& pClusters)
+{
+    struct Cluster {
+        double mArea = 0.0;
+        Vec3<double> mCentroid;
+        Vec3<double> mNormal;
+    };
+
+    std::vector<Cluster> clusters(pClusters.size());
+    Vec3<double> meshCentroid;
+    double meshArea = 0.0;
+
+    for (std::size_t c = 0; c < pClusters.size(); ++c) {
+        const std::size_t end = c + 1 < pClusters.size()
+                              ? pClusters[c + 1] : pOrder.size();
+        Cluster& cluster = clusters[c];
+
+        for (std::size_t t = pClusters[c]; t < end; ++t) {
+            const Vec4<T>& a = pPositions[pIndices[3 * pOrder[t] + 0]];
+            const Vec4<T>& b = pPositions[pIndices[3 * pOrder[t] + 1]];
+            const Vec4<T>& d = pPositions[pIndices[3 * pOrder[t] + 2]];
+
+            const Vec3<double> ab(double(b.x) - a.x, double(b.y) - a.y,
+                                  double(b.z) - a.z);
+            const Vec3<double> ad(double(d.x) - a.x, double(d.y) - a.y,
+                                  double(d.z) - a.z);
+            const Vec3<double> cross(ab.y * ad.z - ab.z * ad.y,
+                                     ab.z * ad.x - ab.x * ad.z,
+                                     ab.x * ad.y - ab.y * ad.x);
+            const double area = 0.5 * std::sqrt(cross.x * cross.x +
+                                                cross.y * cross.y +
+                                                cross.z * cross.z);
+            const double w = area / 3.0;
+
+            cluster.mArea += area;
+            cluster.mCentroid += Vec3<double>(w * (double(a.x) + b.x + d.x),
+                                              w * (double(a.y) + b.y + d.y),
+                                              w * (double(a.z) + b.z + d.z));
+            cluster.mNormal += cross;
+        }
+
+        meshArea += cluster.mArea;
+        meshCentroid += cluster.mCentroid;
+        if (cluster.mArea > 0.0)
+            cluster.mCentroid /= cluster.mArea;
+    }
+
+    if (meshArea > 0.0)
+        meshCentroid /= meshArea;
+
+    using KeyIndex = std::pair<double, uint32_t>;
+    std::vector<KeyIndex> keys(clusters.size());
+    for (std::size_t c = 0; c < clusters.size(); ++c) {
+        const Cluster& cluster = clusters[c];
+        double key = 0.0;
+        const double length = std::sqrt(cluster.mNormal.x * cluster.mNormal.x +
+                                        cluster.mNormal.y * cluster.mNormal.y +
+                                        cluster.mNormal.z * cluster.mNormal.z);
+        if (cluster.mArea > 0.0 && length > 0.0) {
+            key = ((cluster.mCentroid.x - meshCentroid.x) * cluster.mNormal.x +
+                   (cluster.mCentroid.y - meshCentroid.y) * cluster.mNormal.y +
+                   (cluster.mCentroid.z - meshCentroid.z) * cluster.mNormal.z)
+                / length;
+        }
+        keys[c] = KeyIndex(-key, static_cast<uint32_t>(c));
+    }
+    std::stable_sort(keys.begin(), keys.end(),
+                     [](const KeyIndex& pLhs, const KeyIndex& pRhs) {
+                         return pLhs.first < pRhs.first;
+                     });
+
+    std::vector<uint32_t> order;
+    order.reserve(pOrder.size());
+    for (const KeyIndex& key : keys) {
+        const std::size_t c = key.second;
+        const std::size_t end = c + 1 < pClusters.size()
+                              ? pClusters[c + 1] : pOrder.size();
+        order.insert(order.end(), pOrder.begin() + pClusters[c],
+                     pOrder.begin() + end);
+    }
+
+    return order;
+}
+
+}  // namespace internal
+
+template<typename T>
+void makeIndexed(const meshio::stl::Data<T> &pObject,
+                 meshio::stl::IndexedData<T> &pIndexed)
+{
+    using internal::INVALID_INDEX;
+
+    const std::vector< Vec4<T> >& positions = pObject.mPositions;
+
+    pIndexed.clear();
+    pIndexed.mNormals = pObject.mNormals;
+    pIndexed.mIndices.resize(positions.size());
+
+    /* Open addressing table of vertex indices, at most half full */
+    std::size_t capacity = 16;
+    while (capacity < 2 * positions.size())
+        capacity *= 2;
+    std::vector<uint32_t> table(capacity, INVALID_INDEX);
+    const std::size_t mask = capacity - 1;
+
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+        std::size_t slot = internal::hashPosition(positions[i]) & mask;
+        while (table[slot] != INVALID_INDEX &&
+               !internal::samePosition(pIndexed.mPositions[table[slot]],
+                                       positions[i]))
+            slot = (slot + 1) & mask;
+
+        if (table[slot] == INVALID_INDEX) {
+            table[slot] = static_cast<uint32_t>(pIndexed.mPositions.size());
+            pIndexed.mPositions.push_back(positions[i]);
+        }
+        pIndexed.mIndices[i] = table[slot];
+    }
+}
+
+inline float acmr(const std::vector<uint32_t> &pIndices,
+                  const std::size_t pNumVertices, const unsigned pCacheSize)
+{
+    if (pIndices.size() < 3)
+        return 0.0f;
+
+    /* FIFO cache: a vertex is resident while fewer than pCacheSize misses
+       happened since it was loaded. Indices past pNumVertices always miss */
+    std::vector<uint32_t> loadedAt(pNumVertices, internal::INVALID_INDEX);
+    uint32_t misses = 0;
+    for (uint32_t index : pIndices) {
+        if (index >= pNumVertices) {
+            ++misses;
+            continue;
+        }
+        const uint32_t stamp = loadedAt[index];
+        if (stamp == internal::INVALID_INDEX || misses - stamp >= pCacheSize) {
+            loadedAt[index] = misses;
+            ++misses;
+        }
+    }
+
+    return float(misses) / float(pIndices.size() / 3);
+}
+
+template<typename T>
+VertexCacheStats optimizeVertexCache(meshio::stl::IndexedData<T> &pIndexed,
+                                     const unsigned pCacheSize,
+                                     const float pOverdrawThreshold)
+{
+    VertexCacheStats stats;
+    const std::size_t numVertices = pIndexed.mPositions.size();
+    const std::size_t numTriangles = pIndexed.mIndices.size() / 3;
+
+    /* IndexedData is filled in by users too; leave inconsistent meshes
+       untouched rather than index past mPositions */
+    if (pIndexed.mNormals.size() != numTriangles ||
+        pIndexed.mIndices.size() != 3 * numTriangles ||
+        std::any_of(pIndexed.mIndices.begin(), pIndexed.mIndices.end(),
+                    [numVertices](uint32_t pIndex) {
+                        return pIndex >= numVertices;
+                    }))
+        return stats;
+
+    stats.mAcmrBefore = acmr(pIndexed.mIndices, numVertices, pCacheSize);
+
+    std::vector<uint32_t> clusters;
+    std::vector<uint32_t> order =
+        internal::tipsify(pIndexed.mIndices, numVertices, pCacheSize, clusters);
+
+    if (pOverdrawThreshold > 0.0f && !order.empty()) {
+        clusters = internal::splitClusters(pIndexed.mIndices, order, clusters,
+                                           numVertices, pCacheSize,
+                                           pOverdrawThreshold);
+        order = internal::sortClusters(pIndexed.mPositions, pIndexed.mIndices,
+                                       order, clusters);
+    }
+    stats.mClusters = static_cast<uint32_t>(clusters.size());
+
+    /* Apply the triangle order, renumbering vertices by first use so that
+       vertex fetches walk mPositions front to back */
+    std::vector<uint32_t>      remap(numVertices, internal::INVALID_INDEX);
+    std::vector< Vec4<T> >     positions;
+    std::vector< Vec3<float> > normals(numTriangles);
+    std::vector<uint32_t>      indices(pIndexed.mIndices.size());
+    positions.reserve(numVertices);
+
+    for (std::size_t t = 0; t < numTriangles; ++t) {
+        const uint32_t triangle = order[t];
+        normals[t] = pIndexed.mNormals[triangle];
+        for (int i = 0; i < 3; ++i) {
+            const uint32_t v = pIndexed.mIndices[3 * triangle + i];
+            if (remap[v] == internal::INVALID_INDEX) {
+                remap[v] = static_cast<uint32_t>(positions.size());
+                positions.push_back(pIndexed.mPositions[v]);
+            }
+            indices[3 * t + i] = remap[v];
+        }
+    }
+
+    pIndexed.mPositions.swap(positions);
+    pIndexed.mNormals.swap(normals);
+    pIndexed.mIndices.swap(indices);
+
+    stats.mAcmrAfter = acmr(pIndexed.mIndices, pIndexed.mPositions.size(),
+                            pCacheSize);
+    return stats;
+}
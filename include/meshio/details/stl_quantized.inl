@@ -0,0 +1,481 @@
+/*
+ * Copyright (c) 2015, Lakshman Anumolu, Pradeep Garigipati
+ * All rights reserved.
+ *
+ * This file is part of MeshIO whose distribution is governed by
+ * the BSD 2-Clause License contained in the accompanying LICENSE.txt
+ * file.
+ */
+
+namespace internal {
+
+constexpr float QUANTIZED_POSITION_MAX = 65535.0f;
+
+static_assert(sizeof(Vec3<uint16_t>) == 3 * sizeof(uint16_t),
+              "Vec3<uint16_t> must be tightly packed");
+
+/* Bits per octahedral component stored in N */
+template<typename N>
+constexpr unsigned octBits()
+{
+    static_assert(std::is_same<N, uint16_t>::value ||
+                  std::is_same<N, uint32_t>::value,
+                  "Quantized normals are stored in uint16_t or uint32_t");
+    return 4 * sizeof(N);
+}
+
+inline float signNotZero(const float pValue)
+{
+    return pValue >= 0.0f ? 1.0f : -1.0f;
+}
+
+/*
+ * Octahedral normal encoding, "A Survey of Efficient Representations for
+ * Independent Unit Vectors", Cigolle et al., JCGT 2014.
+ */
+template<typename N>
+Vec3<float> decodeNormal(const N pNormal)
+{
+    constexpr unsigned bits = octBits<N>();
+    constexpr uint32_t mask = (1u << bits) - 1;
+    constexpr float scale = 2.0f / float(mask);
+
+    const float u = float(pNormal & mask) * scale - 1.0f;
+    const float v = float((pNormal >> bits) & mask) * scale - 1.0f;
+
+    /* Branch free unfolding of the lower hemisphere */
+    Vec3<float> n(u, v, 1.0f - std::fabs(u) - std::fabs(v));
+    const float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+
+    const float invLength = 1.0f / std::sqrt(n.x*n.x + n.y*n.y + n.z*n.z);
+    n *= invLength;
+    return n;
+}
+
+template<typename N>
+N encodeNormal(const Vec3<float>& pNormal)
+{
+    constexpr unsigned bits = octBits<N>();
+    constexpr float maxValue = float((1u << bits) - 1);
+
+    const float l1 = std::fabs(pNormal.x) + std::fabs(pNormal.y) +
+                     std::fabs(pNormal.z);
+    float u = 0.0f, v = 0.0f;
+    if (l1 > 0.0f) {
+        u = pNormal.x / l1;
+        v = pNormal.y / l1;
+        if (pNormal.z < 0.0f) {
+            const float fu = (1.0f - std::fabs(v)) * signNotZero(u);
+            const float fv = (1.0f - std::fabs(u)) * signNotZero(v);
+            u = fu;
+            v = fv;
+        }
+    }
+
+    /* Of the four grid points around (u, v) keep the one that decodes
+       closest to pNormal, as rounding alone is not optimal on the sphere */
+    const float fu = std::floor((u * 0.5f + 0.5f) * maxValue);
+    const float fv = std::floor((v * 0.5f + 0.5f) * maxValue);
+
+    /* Double precision, since float cannot tell 16 bit neighbours apart */
+    N best = 0;
+    double bestDot = -2.0;
+    for (int du = 0; du < 2; ++du) {
+        for (int dv = 0; dv < 2; ++dv) {
+            const uint32_t qu = uint32_t(std::min(fu + du, maxValue));
+            const uint32_t qv = uint32_t(std::min(fv + dv, maxValue));
+            const N candidate = static_cast<N>(qu | (qv << bits));
+            const Vec3<float> n = decodeNormal<N>(candidate);
+            const double d = double(n.x) * pNormal.x +
+                             double(n.y) * pNormal.y +
+                             double(n.z) * pNormal.z;
+            if (d > bestDot) {
+                bestDot = d;
+                best = candidate;
+            }
+        }
+    }
+    return best;
+}
+
+/* Running bounding box of positions */
+struct Bounds {
+    Vec3<float> mMin;
+    Vec3<float> mMax;
+    bool        mEmpty = true;
+
+    template<typename T>
+    void extend(const Vec4<T>* pPositions, const std::size_t pCount)
+    {
+        if (!pCount)
+            return;
+        if (mEmpty) {
+            mMin = mMax = Vec3<float>(float(pPositions[0].x),
+                                      float(pPositions[0].y),
+                                      float(pPositions[0].z));
+            mEmpty = false;
+        }
+        for (std::size_t i = 0; i < pCount; ++i) {
+            const float x = float(pPositions[i].x);
+            const float y = float(pPositions[i].y);
+            const float z = float(pPositions[i].z);
+            mMin = Vec3<float>(std::min(mMin.x, x), std::min(mMin.y, y),
+                               std::min(mMin.z, z));
+            mMax = Vec3<float>(std::max(mMax.x, x), std::max(mMax.y, y),
+                               std::max(mMax.z, z));
+        }
+    }
+};
+
+/*
+ * Quantizes pCount positions into pQuantized starting at vertex pFirst.
+ * mOrigin and mStep of pQuantized must already be set.
+ */
+template<typename T, typename N>
+void quantizePositions(const Vec4<T>* pPositions, const std::size_t pCount,
+                       const std::size_t pFirst,
+                       meshio::stl::QuantizedData<N>& pQuantized)
+{
+    auto inverse = [](const float pStep) {
+        return pStep > 0.0f ? 1.0f / pStep : 0.0f;
+    };
+    const Vec3<float> origin = pQuantized.mOrigin;
+    const Vec3<float> invStep(inverse(pQuantized.mStep.x),
+                              inverse(pQuantized.mStep.y),
+                              inverse(pQuantized.mStep.z));
+
+    auto quantizeValue = [](const float pValue) -> uint16_t {
+        const float q = std::min(std::max(pValue + 0.5f, 0.0f),
+                                 QUANTIZED_POSITION_MAX);
+        return static_cast<uint16_t>(q);
+    };
+
+    Vec3<uint16_t>* positions = pQuantized.mPositions.data() + pFirst;
+    for (std::size_t i = 0; i < pCount; ++i)
+        positions[i] = Vec3<uint16_t>(
+            quantizeValue((float(pPositions[i].x) - origin.x) * invStep.x),
+            quantizeValue((float(pPositions[i].y) - origin.y) * invStep.y),
+            quantizeValue((float(pPositions[i].z) - origin.z) * invStep.z));
+}
+
+template<typename N>
+void encodeNormals(const Vec3<float>* pNormals, const std::size_t pCount,
+                   const std::size_t pFirst,
+                   meshio::stl::QuantizedData<N>& pQuantized)
+{
+    N* normals = pQuantized.mNormals.data() + pFirst;
+    for (std::size_t i = 0; i < pCount; ++i)
+        normals[i] = encodeNormal<N>(pNormals[i]);
+}
+
+template<typename N>
+void setQuantizationBox(const Bounds& pBounds,
+                        meshio::stl::QuantizedData<N>& pQuantized)
+{
+    pQuantized.mOrigin = pBounds.mMin;
+    pQuantized.mStep = Vec3<float>(
+        (pBounds.mMax.x - pBounds.mMin.x) / QUANTIZED_POSITION_MAX,
+        (pBounds.mMax.y - pBounds.mMin.y) / QUANTIZED_POSITION_MAX,
+        (pBounds.mMax.z - pBounds.mMin.z) / QUANTIZED_POSITION_MAX);
+}
+
+/*
+ * Binary counterpart of readBinarySTL for quantized storage. Every object is
+ * read twice in blocks, once for its bounding box and once to quantize, so
+ * no full precision copy of the object is ever held.
+ */
+template<typename N>
+void readBinarySTLQuantized(std::vector< meshio::stl::QuantizedData<N> > &pObjects,
+                            const char* pFileName)
+{
+    uint32_t numTriangles = 0;
+    std::vector<char>          block(BINARY_BLOCK_FACETS * BINARY_FACET_SIZE);
+    std::vector< Vec3<float> > normals(BINARY_BLOCK_FACETS);
+    std::vector< Vec4<float> > positions(3 * BINARY_BLOCK_FACETS);
+
+    std::ifstream ifs(pFileName, std::ios::binary | std::ios::in);
+
+    char header[80];
+    ifs.read(&header[0], 80);
+
+    ifs.read((char *)&numTriangles, sizeof(uint32_t));
+
+    while (ifs && numTriangles) {
+        const std::streampos start = ifs.tellg();
+
+        Bounds bounds;
+        for (uint32_t facet = 0; facet < numTriangles;) {
+            const std::size_t count =
+                std::min<std::size_t>(numTriangles - facet, BINARY_BLOCK_FACETS);
+            ifs.read(block.data(), count * BINARY_FACET_SIZE);
+            BinaryFacetCodec<float>::decode(block.data(), count,
+                                            normals.data(), positions.data());
+            bounds.extend(positions.data(), 3 * count);
+            facet += count;
+        }
+
+        meshio::stl::QuantizedData<N> stlObject;
+        stlObject.resize(numTriangles);
+        setQuantizationBox(bounds, stlObject);
+
+        ifs.seekg(start);
+        for (uint32_t facet = 0; facet < numTriangles;) {
+            const std::size_t count =
+                std::min<std::size_t>(numTriangles - facet, BINARY_BLOCK_FACETS);
+            ifs.read(block.data(), count * BINARY_FACET_SIZE);
+            BinaryFacetCodec<float>::decode(block.data(), count,
+                                            normals.data(), positions.data());
+            encodeNormals(normals.data(), count, facet, stlObject);
+            quantizePositions(positions.data(), 3 * count, 3 * facet,
+                              stlObject);
+            facet += count;
+        }
+        pObjects.push_back(std::move(stlObject));
+
+        numTriangles = 0;
+        ifs.read((char *)&numTriangles, sizeof(uint32_t));
+    }
+
+    ifs.close();
+}
+
+/*
+ * ASCII counterpart of readBinarySTLQuantized. The first pass gathers the
+ * bounds and sizes of every solid, the second parses the file again and
+ * quantizes facets in blocks of BINARY_BLOCK_FACETS as they are read.
+ */
+template<typename N>
+void readAsciiSTLQuantized(std::vector< meshio::stl::QuantizedData<N> > &pObjects,
+                           const char* pFileName)
+{
+    struct Extent {
+        Bounds      mBounds;
+        std::size_t mNumNormals   = 0;
+        std::size_t mNumPositions = 0;
+    };
+
+    struct ExtentScan {
+        std::vector<Extent> mExtents;
+
+        void beginSolid() { mExtents.emplace_back(); }
+        void normal(const Vec3<float>&) { ++mExtents.back().mNumNormals; }
+        void vertex(const Vec4<float>& pPosition) {
+            mExtents.back().mBounds.extend(&pPosition, 1);
+            ++mExtents.back().mNumPositions;
+        }
+        void endSolid() {}
+    };
+
+    struct QuantizeScan {
+        std::vector< meshio::stl::QuantizedData<N> >& mObjects;
+        const std::vector<Extent>&                    mExtents;
+        std::vector< Vec3<float> > mNormals;
+        std::vector< Vec4<float> > mPositions;
+        std::size_t mNormalsDone   = 0;
+        std::size_t mPositionsDone = 0;
+
+        /* Solids the first pass did not see, should the file change in
+           between, are dropped along with any extra facets */
+        meshio::stl::QuantizedData<N>* current() {
+            return mObjects.size() <= mExtents.size() && !mObjects.empty()
+                 ? &mObjects.back() : nullptr;
+        }
+
+        void flush() {
+            meshio::stl::QuantizedData<N>* object = current();
+            if (object) {
+                const std::size_t numNormals = std::min(mNormals.size(),
+                    object->mNormals.size() - mNormalsDone);
+                const std::size_t numPositions = std::min(mPositions.size(),
+                    object->mPositions.size() - mPositionsDone);
+                encodeNormals(mNormals.data(), numNormals, mNormalsDone,
+                              *object);
+                quantizePositions(mPositions.data(), numPositions,
+                                  mPositionsDone, *object);
+                mNormalsDone   += numNormals;
+                mPositionsDone += numPositions;
+            }
+            mNormals.clear();
+            mPositions.clear();
+        }
+
+        void beginSolid() {
+            mObjects.emplace_back();
+            mNormalsDone = mPositionsDone = 0;
+            if (mObjects.size() > mExtents.size())
+                return;
+            const Extent& extent = mExtents[mObjects.size() - 1];
+            mObjects.back().mNormals.resize(extent.mNumNormals);
+            mObjects.back().mPositions.resize(extent.mNumPositions);
+            setQuantizationBox(extent.mBounds, mObjects.back());
+        }
+        void normal(const Vec3<float>& pNormal) {
+            mNormals.push_back(pNormal);
+            if (mNormals.size() == BINARY_BLOCK_FACETS)
+                flush();
+        }
+        void vertex(const Vec4<float>& pPosition) {
+            mPositions.push_back(pPosition);
+            if (mPositions.size() == 3 * BINARY_BLOCK_FACETS)
+                flush();
+        }
+        void endSolid() { flush(); }
+    };
+
+    ExtentScan extents;
+    scanAsciiSTL<float>(pFileName, extents);
+
+    QuantizeScan quantizer{pObjects, extents.mExtents, {}, {}};
+    quantizer.mNormals.reserve(BINARY_BLOCK_FACETS);
+    quantizer.mPositions.reserve(3 * BINARY_BLOCK_FACETS);
+    scanAsciiSTL<float>(pFileName, quantizer);
+
+    if (pObjects.size() > extents.mExtents.size())
+        pObjects.resize(extents.mExtents.size());
+}
+
+}  // namespace internal
+
+template<class N>
+Vec3<float> QuantizedData<N>::normal(std::size_t pIndex) const
+{
+    return internal::decodeNormal<N>(mNormals[pIndex]);
+}
+
+template<class N>
+void QuantizedData<N>::positions(std::size_t pBegin, std::size_t pCount,
+                                 Vec4<float>* pOut) const
+{
+    std::size_t i = 0;
+#if defined(MESHIO_SSE2)
+    /* Four vertices, 24 bytes, per iteration from one 16 and one 8 byte
+       load. Each vertex is shifted down to the low lanes; the zero w step
+       cancels whatever follows it and the origin supplies w = 1 */
+    const __m128 origin = _mm_setr_ps(mOrigin.x, mOrigin.y, mOrigin.z, 1.0f);
+    const __m128 step   = _mm_setr_ps(mStep.x, mStep.y, mStep.z, 0.0f);
+    const __m128i zero  = _mm_setzero_si128();
+    const Vec3<uint16_t>* src = mPositions.data() + pBegin;
+
+    auto dequantize = [&](const __m128i pQ16, Vec4<float>* pDst) {
+        const __m128 q = _mm_cvtepi32_ps(_mm_unpacklo_epi16(pQ16, zero));
+        _mm_storeu_ps(&pDst->x, _mm_add_ps(_mm_mul_ps(q, step), origin));
+    };
+
+    for (; i + 4 <= pCount; i += 4) {
+        const __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128i b = _mm_loadl_epi64((const __m128i *)(src + i) + 1);
+        dequantize(a, pOut + i);
+        dequantize(_mm_srli_si128(a, 6), pOut + i + 1);
+        dequantize(_mm_or_si128(_mm_srli_si128(a, 12), _mm_slli_si128(b, 4)),
+                   pOut + i + 2);
+        dequantize(_mm_srli_si128(b, 2), pOut + i + 3);
+    }
+#endif
+    for (; i < pCount; ++i)
+        pOut[i] = position(pBegin + i);
+}
+
+template<class N>
+void QuantizedData<N>::normals(std::size_t pBegin, std::size_t pCount,
+                               Vec3<float>* pOut) const
+{
+    const N* src = mNormals.data() + pBegin;
+    std::size_t i = 0;
+#if defined(MESHIO_SSE2)
+    static_assert(sizeof(Vec3<float>) == 3 * sizeof(float),
+                  "Vec3<float> must be tightly packed");
+
+    /* decodeNormal on four normals at a time, in the same operation order
+       so that both produce identical results */
+    constexpr unsigned bits = internal::octBits<N>();
+    constexpr float scale = 2.0f / float((1u << bits) - 1);
+
+    const __m128i mask     = _mm_set1_epi32((1 << bits) - 1);
+    const __m128  signMask = _mm_set1_ps(-0.0f);
+    const __m128  vScale   = _mm_set1_ps(scale);
+    const __m128  one      = _mm_set1_ps(1.0f);
+    const __m128  zero     = _mm_setzero_ps();
+
+    for (; i + 4 <= pCount; i += 4) {
+        __m128i packed;
+        if constexpr (sizeof(N) == sizeof(uint16_t))
+            packed = _mm_unpacklo_epi16(
+                _mm_loadl_epi64((const __m128i *)(src + i)),
+                _mm_setzero_si128());
+        else
+            packed = _mm_loadu_si128((const __m128i *)(src + i));
+
+        const __m128 u = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+            _mm_and_si128(packed, mask)), vScale), one);
+        const __m128 v = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+            _mm_and_si128(_mm_srli_epi32(packed, bits), mask)), vScale), one);
+
+        /* Unfold the lower hemisphere: x -= copysign(t, x), same for y */
+        __m128 x = u, y = v;
+        __m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, u)),
+                              _mm_andnot_ps(signMask, v));
+        const __m128 t = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+        x = _mm_sub_ps(x, _mm_xor_ps(t, _mm_and_ps(x, signMask)));
+        y = _mm_sub_ps(y, _mm_xor_ps(t, _mm_and_ps(y, signMask)));
+
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        const __m128 invLength = _mm_div_ps(one, length);
+        x = _mm_mul_ps(x, invLength);
+        y = _mm_mul_ps(y, invLength);
+        z = _mm_mul_ps(z, invLength);
+
+        /* Four xyz_ rows, packed into the 48 bytes of four Vec3<float> */
+        __m128 r0 = x, r1 = y, r2 = z, r3 = zero;
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        const __m128 z0x1 = _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(0, 0, 2, 2));
+        const __m128 z2x3 = _mm_shuffle_ps(r2, r3, _MM_SHUFFLE(0, 0, 2, 2));
+        float* dst = &pOut[i].x;
+        _mm_storeu_ps(dst,     _mm_shuffle_ps(r0, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(dst + 4, _mm_shuffle_ps(r1, r2, _MM_SHUFFLE(1, 0, 2, 1)));
+        _mm_storeu_ps(dst + 8, _mm_shuffle_ps(z2x3, r3, _MM_SHUFFLE(2, 1, 2, 0)));
+    }
+#endif
+    for (; i < pCount; ++i)
+        pOut[i] = internal::decodeNormal<N>(src[i]);
+}
+
+template<typename T, typename N>
+void quantize(const meshio::stl::Data<T> &pObject,
+              meshio::stl::QuantizedData<N> &pQuantized)
+{
+    internal::Bounds bounds;
+    bounds.extend(pObject.mPositions.data(), pObject.mPositions.size());
+
+    pQuantized.clear();
+    pQuantized.mPositions.resize(pObject.mPositions.size());
+    pQuantized.mNormals.resize(pObject.mNormals.size());
+    internal::setQuantizationBox(bounds, pQuantized);
+
+    internal::quantizePositions(pObject.mPositions.data(),
+                                pObject.mPositions.size(), 0, pQuantized);
+    internal::encodeNormals(pObject.mNormals.data(), pObject.mNormals.size(),
+                            0, pQuantized);
+}
+
+template<typename N>
+bool read(std::vector< meshio::stl::QuantizedData<N> > &pObjects,
+          const char* pFileName)
+{
+    for (unsigned int i = 0; i < pObjects.size(); ++i)
+        pObjects[i].clear();
+    pObjects.clear();
+
+    Format format;
+    if (!internal::detectFormat(pFileName, format))
+        return false;
+
+    if (format == Format::Ascii)
+        internal::readAsciiSTLQuantized<N>(pObjects, pFileName);
+    else
+        internal::readBinarySTLQuantized<N>(pObjects, pFileName);
+
+    return true;
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2015, Lakshman Anumolu, Pradeep Garigipati
+ * All rights reserved.
+ *
+ * This file is part of MeshIO whose distribution is governed by
+ * the BSD 2-Clause License contained in the accompanying LICENSE.txt
+ * file.
+ */
+
+namespace internal {
+
+/* Smallest amount of work, in elements, handed to a separate thread */
+constexpr std::size_t PARALLEL_GRAIN = 16384;
+
+/* Bits per axis of the quantized centroids, 3 * 21 bits fit a uint64_t */
+constexpr unsigned SPATIAL_KEY_BITS = 21;
+
+/* Number of threads for pCount elements, at most pMaxThreads or the
+   hardware concurrency when pMaxThreads is zero */
+inline unsigned parallelChunks(const std::size_t pCount,
+                               const unsigned pMaxThreads = 0)
+{
+    const std::size_t maxThreads = pMaxThreads ? pMaxThreads
+        : std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t chunks = (pCount + PARALLEL_GRAIN - 1) / PARALLEL_GRAIN;
+    return static_cast<unsigned>(std::max<std::size_t>(1,
+                                 std::min(maxThreads, chunks)));
+}
+
+/*
+ * Splits [0, pCount) into pChunks contiguous ranges and invokes
+ * pFunc(chunk, begin, end) for each of them, one thread per range. The
+ * calling thread processes the first range.
+ */
+template<typename Func>
+void parallelFor(const std::size_t pCount, const unsigned pChunks, Func pFunc)
+{
+    const std::size_t chunkSize = (pCount + pChunks - 1) / pChunks;
+
+    std::vector<std::thread> threads;
+    for (unsigned chunk = 1; chunk < pChunks; ++chunk) {
+        const std::size_t begin = std::min(pCount, chunk * chunkSize);
+        const std::size_t end = std::min(pCount, begin + chunkSize);
+        threads.emplace_back(pFunc, chunk, begin, end);
+    }
+    pFunc(0u, std::size_t(0), std::min(pCount, chunkSize));
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+/* Spreads the lower 21 bits of pValue to every third bit */
+inline uint64_t expandBits(uint64_t pValue)
+{
+    pValue &= 0x1fffff;
+    pValue = (pValue | pValue << 32) & 0x1f00000000ffffULL;
+    pValue = (pValue | pValue << 16) & 0x1f0000ff0000ffULL;
+    pValue = (pValue | pValue << 8)  & 0x100f00f00f00f00fULL;
+    pValue = (pValue | pValue << 4)  & 0x10c30c30c30c30c3ULL;
+    pValue = (pValue | pValue << 2)  & 0x1249249249249249ULL;
+    return pValue;
+}
+
+inline uint64_t mortonKey(uint32_t pX, uint32_t pY, uint32_t pZ)
+{
+    return (expandBits(pX) << 2) | (expandBits(pY) << 1) | expandBits(pZ);
+}
+
+/*
+ * Hilbert curve index from J. Skilling, "Programming the Hilbert curve",
+ * AIP Conference Proceedings 707, 2004: the axes are converted to the
+ * transposed Hilbert index in place, whose bits interleave like a Morton key.
+ */
+inline uint64_t hilbertKey(uint32_t pX, uint32_t pY, uint32_t pZ)
+{
+    uint32_t X[3] = {pX, pY, pZ};
+    const uint32_t M = 1u << (SPATIAL_KEY_BITS - 1);
+
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+        const uint32_t P = Q - 1;
+        for (int i = 0; i < 3; ++i) {
+            if (X[i] & Q) {
+                X[0] ^= P;
+            } else {
+                const uint32_t t = (X[0] ^ X[i]) & P;
+                X[0] ^= t;
+                X[i] ^= t;
+            }
+        }
+    }
+
+    X[1] ^= X[0];
+    X[2] ^= X[1];
+
+    uint32_t t = 0;
+    for (uint32_t Q = M; Q > 1; Q >>= 1)
+        if (X[2] & Q)
+            t ^= Q - 1;
+    for (int i = 0; i < 3; ++i)
+        X[i] ^= t;
+
+    return mortonKey(X[0], X[1], X[2]);
+}
+
+/*
+ * Sorts the triangles of pObject along a space filling curve through their
+ * centroids. Positions and normals are permuted together. Bounding box,
+ * keys, sort and gather all run on parallelChunks() threads.
+ */
+template<typename T>
+void spatialSort(meshio::stl::Data<T>& pObject, const SpatialOrder pOrder,
+                 const unsigned pNumThreads = 0)
+{
+    const std::size_t numTriangles = pObject.mNormals.size();
+    if (pOrder == SpatialOrder::None || numTriangles < 2 ||
+        pObject.mPositions.size() != 3 * numTriangles)
+        return;
+
+    const unsigned chunks = parallelChunks(numTriangles, pNumThreads);
+    const Vec4<T>* positions = pObject.mPositions.data();
+
+    auto centroid = [positions](const std::size_t pTriangle) -> Vec3<T> {
+        const Vec4<T>& a = positions[3 * pTriangle + 0];
+        const Vec4<T>& b = positions[3 * pTriangle + 1];
+        const Vec4<T>& c = positions[3 * pTriangle + 2];
+        return Vec3<T>(a.x + b.x + c.x, a.y + b.y + c.y, a.z + b.z + c.z);
+    };
+
+    /* Bounding box of the (unscaled) centroids, reduced per chunk */
+    std::vector< Vec3<T> > chunkMin(chunks, centroid(0));
+    std::vector< Vec3<T> > chunkMax(chunks, centroid(0));
+    parallelFor(numTriangles, chunks,
+        [&](unsigned pChunk, std::size_t pBegin, std::size_t pEnd) {
+            Vec3<T> lo = chunkMin[pChunk], hi = chunkMax[pChunk];
+            for (std::size_t i = pBegin; i < pEnd; ++i) {
+                const Vec3<T> c = centroid(i);
+                lo = Vec3<T>(std::min(lo.x, c.x), std::min(lo.y, c.y),
+                             std::min(lo.z, c.z));
+                hi = Vec3<T>(std::max(hi.x, c.x), std::max(hi.y, c.y),
+                             std::max(hi.z, c.z));
+            }
+            chunkMin[pChunk] = lo;
+            chunkMax[pChunk] = hi;
+        });
+
+    Vec3<T> lo = chunkMin[0], hi = chunkMax[0];
+    for (unsigned chunk = 1; chunk < chunks; ++chunk) {
+        lo = Vec3<T>(std::min(lo.x, chunkMin[chunk].x),
+                     std::min(lo.y, chunkMin[chunk].y),
+                     std::min(lo.z, chunkMin[chunk].z));
+        hi = Vec3<T>(std::max(hi.x, chunkMax[chunk].x),
+                     std::max(hi.y, chunkMax[chunk].y),
+                     std::max(hi.z, chunkMax[chunk].z));
+    }
+
+    const double maxCoord = double((1u << SPATIAL_KEY_BITS) - 1);
+    auto scaleOf = [maxCoord](T pLo, T pHi) {
+        return pHi > pLo ? maxCoord / (double(pHi) - double(pLo)) : 0.0;
+    };
+    const double sx = scaleOf(lo.x, hi.x);
+    const double sy = scaleOf(lo.y, hi.y);
+    const double sz = scaleOf(lo.z, hi.z);
+
+    using KeyIndex = std::pair<uint64_t, uint32_t>;
+    std::vector<KeyIndex> keys(numTriangles);
+
+    const std::size_t chunkSize = (numTriangles + chunks - 1) / chunks;
+    parallelFor(numTriangles, chunks,
+        [&](unsigned, std::size_t pBegin, std::size_t pEnd) {
+            for (std::size_t i = pBegin; i < pEnd; ++i) {
+                const Vec3<T> c = centroid(i);
+                const uint32_t x = uint32_t((double(c.x) - lo.x) * sx);
+                const uint32_t y = uint32_t((double(c.y) - lo.y) * sy);
+                const uint32_t z = uint32_t((double(c.z) - lo.z) * sz);
+                const uint64_t key = pOrder == SpatialOrder::Hilbert
+                                   ? hilbertKey(x, y, z)
+                                   : mortonKey(x, y, z);
+                keys[i] = KeyIndex(key, static_cast<uint32_t>(i));
+            }
+            std::sort(keys.begin() + pBegin, keys.begin() + pEnd);
+        });
+
+    /* Merge the sorted chunks pairwise until one sorted run remains */
+    for (std::size_t width = chunkSize; width < numTriangles; width *= 2) {
+        const std::size_t numMerges =
+            (numTriangles + 2 * width - 1) / (2 * width);
+        parallelFor(numMerges, static_cast<unsigned>(numMerges),
+            [&](unsigned, std::size_t pBegin, std::size_t pEnd) {
+                for (std::size_t m = pBegin; m < pEnd; ++m) {
+                    const std::size_t begin = 2 * width * m;
+                    const std::size_t middle = std::min(numTriangles,
+                                                        begin + width);
+                    const std::size_t end = std::min(numTriangles,
+                                                     begin + 2 * width);
+                    std::inplace_merge(keys.begin() + begin,
+                                       keys.begin() + middle,
+                                       keys.begin() + end);
+                }
+            });
+    }
+
+    std::vector< Vec4<T> >     sortedPositions(pObject.mPositions.size());
+    std::vector< Vec3<float> > sortedNormals(numTriangles);
+    parallelFor(numTriangles, chunks,
+        [&](unsigned, std::size_t pBegin, std::size_t pEnd) {
+            for (std::size_t i = pBegin; i < pEnd; ++i) {
+                const std::size_t src = keys[i].second;
+                sortedNormals[i] = pObject.mNormals[src];
+                sortedPositions[3 * i + 0] = positions[3 * src + 0];
+                sortedPositions[3 * i + 1] = positions[3 * src + 1];
+                sortedPositions[3 * i + 2] = positions[3 * src + 2];
+            }
+        });
+
+    pObject.mPositions.swap(sortedPositions);
+    pObject.mNormals.swap(sortedNormals);
+}
+
+}  // namespace internal
@@ -15,8 +15,23 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <iostream>
 #include <sstream>
 #include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <random>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHIO_SSE2
+#endif
 
 namespace meshio {
 namespace stl {
@@ -26,6 +41,13 @@ enum class Format {
     Binary,
 };
 
+/* Space filling curve used to order triangles by their centroids */
+enum class SpatialOrder {
+    None,
+    Morton,
+    Hilbert,
+};
+
 /* class to store data from STL file */
 template<class T>
 class Data {
@@ -68,13 +90,166 @@ class Data {
     }
 };
 
+/* Indexed triangle mesh built from Data, with one normal per triangle */
+template<class T>
+class IndexedData {
+  public:
+    std::vector< Vec4<T> >      mPositions;
+    std::vector< Vec3<float> >  mNormals;
+    std::vector< uint32_t >     mIndices;
+
+    IndexedData() {}
+
+    ~IndexedData() {
+        this->clear();
+    }
+
+    void clear() {
+        mPositions.clear();
+        mNormals.clear();
+        mIndices.clear();
+    }
+};
+
+/*
+ * Compact storage of Data: positions quantized to 16 bits per axis against
+ * the object's bounding box and normals octahedral encoded in N, which is
+ * uint16_t (8 bits per component) or uint32_t (16 bits per component).
+ *
+ * Error bounds: every dequantized position coordinate lies within half a
+ * quantization step, mStep / 2 = extent / 131070, of the original value
+ * (plus float rounding). Decoded normals are unit length and within 0.64
+ * degrees (uint16_t) or 0.008 degrees (uint32_t) of the original direction.
+ * Zero length normals decode to +z.
+ */
+template<class N = uint16_t>
+class QuantizedData {
+  public:
+    /* Position = mOrigin + quantized value * mStep, per axis */
+    Vec3<float>                     mOrigin;
+    Vec3<float>                     mStep;
+    std::vector< Vec3<uint16_t> >   mPositions;
+    std::vector< N >                mNormals;
+
+    QuantizedData() {}
+
+    ~QuantizedData() {
+        this->clear();
+    }
+
+    void resize(unsigned pNumTriangles) {
+        mPositions.resize(3*pNumTriangles);
+        mNormals.resize(pNumTriangles);
+    }
+
+    void clear() {
+        mPositions.clear();
+        mNormals.clear();
+    }
+
+    Vec4<float> position(std::size_t pIndex) const {
+        const Vec3<uint16_t>& q = mPositions[pIndex];
+        return Vec4<float>(mOrigin.x + float(q.x) * mStep.x,
+                           mOrigin.y + float(q.y) * mStep.y,
+                           mOrigin.z + float(q.z) * mStep.z,
+                           1.0f);
+    }
+
+    Vec3<float> normal(std::size_t pIndex) const;
+
+    /* Dequantizes pCount positions starting at pBegin into pOut, four per
+       iteration with SSE2 */
+    void positions(std::size_t pBegin, std::size_t pCount,
+                   Vec4<float>* pOut) const;
+
+    /* Decodes pCount normals starting at pBegin into pOut, four per
+       iteration with SSE2. Results equal normal() for every index */
+    void normals(std::size_t pBegin, std::size_t pCount,
+                 Vec3<float>* pOut) const;
+};
+
+/* Average cache miss ratio (misses per triangle) of an index buffer on a
+   FIFO post-transform vertex cache, before and after optimizeVertexCache */
+struct VertexCacheStats {
+    float    mAcmrBefore = 0.0f;
+    float    mAcmrAfter  = 0.0f;
+    /* Number of triangle clusters ordered to reduce overdraw */
+    uint32_t mClusters   = 0;
+};
+
+/* Optional behaviour of stl::read */
+struct ReadOptions {
+    /* Cache parsed ASCII meshes in a binary file keyed by the source path,
+       size, modification time and content hash. Stale entries are rebuilt */
+    bool        mUseCache = false;
+    /* Directory holding cache files, next to the source file when empty */
+    std::string mCacheDir;
+    /* Compare the source content hash on every lookup rather than relying
+       on size and modification time alone */
+    bool        mVerifyCacheContent = true;
+    /* Sort the triangles of every object read along a space filling curve */
+    SpatialOrder mSpatialOrder = SpatialOrder::None;
+};
+
+/* Optional behaviour of stl::write */
+struct WriteOptions {
+    /* Store the triangles of every object sorted along a space filling
+       curve; pObjects itself is left untouched */
+    SpatialOrder mSpatialOrder = SpatialOrder::None;
+};
+
 template<typename T=float>
-bool read(std::vector< meshio::stl::Data<T> > &pObjects, const char* pFileName);
+bool read(std::vector< meshio::stl::Data<T> > &pObjects, const char* pFileName,
+          const ReadOptions& pOptions = ReadOptions());
 
 template<typename T=float>
 bool write(const char* pFileName,
            const meshio::stl::Format pFormat,
-           const std::vector< meshio::stl::Data<T> > &pObjects);
+           const std::vector< meshio::stl::Data<T> > &pObjects,
+           const WriteOptions& pOptions = WriteOptions());
+
+/* Reorders the triangles of pObject along the space filling curve pOrder
+   through their centroids, permuting positions and normals together. Large
+   objects are sorted on up to pNumThreads threads, zero meaning the
+   hardware concurrency */
+template<typename T=float>
+void spatialSort(meshio::stl::Data<T> &pObject, const SpatialOrder pOrder,
+                 const unsigned pNumThreads = 0);
+
+/* Reads an STL file straight into quantized storage. Either encoding is
+   streamed twice, first for the bounds of every object and then to quantize
+   it block by block, so no full precision copy of an object is held */
+template<typename N=uint16_t>
+bool read(std::vector< meshio::stl::QuantizedData<N> > &pObjects,
+          const char* pFileName);
+
+/* Quantizes the positions and normals of pObject into pQuantized */
+template<typename T=float, typename N=uint16_t>
+void quantize(const meshio::stl::Data<T> &pObject,
+              meshio::stl::QuantizedData<N> &pQuantized);
+
+/* Welds bitwise identical positions of pObject into an indexed mesh, with
+   -0 and +0 treated as equal */
+template<typename T=float>
+void makeIndexed(const meshio::stl::Data<T> &pObject,
+                 meshio::stl::IndexedData<T> &pIndexed);
+
+/* Average cache miss ratio of pIndices on a FIFO cache of pCacheSize */
+inline float acmr(const std::vector<uint32_t> &pIndices,
+                  const std::size_t pNumVertices,
+                  const unsigned pCacheSize = 16);
+
+/* Reorders triangles for post-transform vertex cache reuse (Tipsify) and
+   then vertices in order of first use for fetch locality. Unless
+   pOverdrawThreshold is zero, the triangle order is also cut into clusters
+   wherever a cluster's own ACMR drops below it, and the clusters are sorted
+   outside in to reduce overdraw from any viewpoint. Meshes whose index
+   count does not match their normals, or that index past mPositions, are
+   left as they are and all stats are zero */
+template<typename T=float>
+VertexCacheStats optimizeVertexCache(meshio::stl::IndexedData<T> &pIndexed,
+                                     const unsigned pCacheSize = 16,
+                                     const float pOverdrawThreshold = 0.75f);
 
 #include <meshio/details/stl.inl>
 
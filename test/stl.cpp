@@ -79,7 +79,8 @@ TEST(STL, WRITE_BINARY)
 {
     vector< stl::Data<float> > objs;
     stl::read<float>(objs, TEST_DIR "/cube_ascii.stl");
-    stl::write(TEST_DIR "/cube_ascii2binary.stl", stl::Format::Binary, objs);
+    stl::write(TEST_OUTPUT_DIR "/cube_ascii2binary.stl", stl::Format::Binary,
+               objs);
     objs.clear();
 }
 
@@ -87,7 +88,8 @@ TEST(STL, WRITE_ASCII)
 {
     vector< stl::Data<float> > objs;
     stl::read<float>(objs, TEST_DIR "/cube_binary.stl");
-    stl::write(TEST_DIR "/cube_binary2ascii.stl", stl::Format::Ascii, objs);
+    stl::write(TEST_OUTPUT_DIR "/cube_binary2ascii.stl", stl::Format::Ascii,
+               objs);
 
     objs.clear();
 }
@@ -171,3 +173,644 @@ TEST(STL, CheckReReadIntoSameObject)
 
     EXPECT_TRUE(binReadObjs[0].mPositions.size() == numPositions);
 }
+
+TEST(STL, READ_BINARY_DOUBLE)
+{
+    vector< stl::Data<double> > referenceObjs;
+    initializeReferenceSTLObj(referenceObjs);
+
+    vector< stl::Data<double> > objs;
+    stl::read<double>(objs, TEST_DIR "/cube_binary.stl");
+
+    EXPECT_TRUE(objs[0] == referenceObjs[0]);
+}
+
+TEST(STL, READ_ASCII_DOUBLE)
+{
+    vector< stl::Data<double> > referenceObjs;
+    initializeReferenceSTLObj(referenceObjs);
+
+    vector< stl::Data<double> > objs;
+    stl::read<double>(objs, TEST_DIR "/cube_ascii.stl");
+
+    EXPECT_TRUE(objs[0] == referenceObjs[0]);
+}
+
+TEST(STL, WRITE_BINARY_DOUBLE)
+{
+    vector< stl::Data<double> > objs;
+    stl::read<double>(objs, TEST_DIR "/cube_ascii.stl");
+    stl::write(TEST_OUTPUT_DIR "/cube_double2binary.stl", stl::Format::Binary,
+               objs);
+
+    vector< stl::Data<double> > reReadObjs;
+    stl::read<double>(reReadObjs, TEST_OUTPUT_DIR "/cube_double2binary.stl");
+
+    EXPECT_TRUE(objs[0] == reReadObjs[0]);
+}
+
+TEST(STL, READ_ASCII_CACHED)
+{
+    vector< stl::Data<float> > referenceObjs;
+    initializeReferenceSTLObj(referenceObjs);
+
+    stl::ReadOptions options;
+    options.mUseCache = true;
+    options.mCacheDir = TEST_OUTPUT_DIR "/cache";
+
+    /* Start cold so that both the store and the load paths run */
+    std::filesystem::remove_all(options.mCacheDir);
+
+    /* First read populates the cache, second one is served from it */
+    vector< stl::Data<float> > objs;
+    EXPECT_TRUE(stl::read<float>(objs, TEST_DIR "/cube_ascii.stl", options));
+    EXPECT_TRUE(objs[0] == referenceObjs[0]);
+
+    EXPECT_FALSE(std::filesystem::is_empty(options.mCacheDir));
+
+    vector< stl::Data<float> > cachedObjs;
+    EXPECT_TRUE(stl::read<float>(cachedObjs, TEST_DIR "/cube_ascii.stl",
+                                 options));
+    ASSERT_EQ(cachedObjs.size(), 1u);
+    EXPECT_TRUE(cachedObjs[0] == referenceObjs[0]);
+
+    /* Cache entries are per scalar type */
+    vector< stl::Data<double> > doubleRefObjs;
+    initializeReferenceSTLObj(doubleRefObjs);
+    vector< stl::Data<double> > doubleObjs;
+    EXPECT_TRUE(stl::read<double>(doubleObjs, TEST_DIR "/cube_ascii.stl",
+                                  options));
+    EXPECT_TRUE(doubleObjs[0] == doubleRefObjs[0]);
+}
+
+TEST(STL, READ_ASCII_CACHE_INVALIDATION)
+{
+    stl::ReadOptions options;
+    options.mUseCache = true;
+
+    const char* fileName = TEST_OUTPUT_DIR "/cube_cache_invalidation.stl";
+
+    vector< stl::Data<float> > objs;
+    stl::read<float>(objs, TEST_DIR "/cube_ascii.stl");
+    stl::write(fileName, stl::Format::Ascii, objs);
+
+    vector< stl::Data<float> > cachedObjs;
+    stl::read<float>(cachedObjs, fileName, options);
+    EXPECT_TRUE(cachedObjs[0] == objs[0]);
+
+    /* Rewriting the source with different content must rebuild the entry */
+    objs[0].mPositions[0] = meshio::Vec4<float>(2, 2, 2, 1);
+    stl::write(fileName, stl::Format::Ascii, objs);
+
+    stl::read<float>(cachedObjs, fileName, options);
+    EXPECT_TRUE(cachedObjs[0] == objs[0]);
+}
+
+TEST(STL, READ_ASCII_CACHE_UNVERIFIED)
+{
+    namespace fs = std::filesystem;
+
+    stl::ReadOptions options;
+    options.mUseCache = true;
+    options.mVerifyCacheContent = false;
+
+    const char* fileName = TEST_OUTPUT_DIR "/cube_cache_unverified.stl";
+    fs::remove(std::string(fileName) + ".32.mcache");
+
+    vector< stl::Data<float> > objs;
+    stl::read<float>(objs, TEST_DIR "/cube_ascii.stl");
+    stl::write(fileName, stl::Format::Ascii, objs);
+
+    vector< stl::Data<float> > cachedObjs;
+    stl::read<float>(cachedObjs, fileName, options);
+    EXPECT_TRUE(cachedObjs[0] == objs[0]);
+
+    /* Same size and modification time but different content: without
+       verification the entry is still a hit, with it the entry is rebuilt */
+    const auto size = fs::file_size(fileName);
+    const auto mtime = fs::last_write_time(fileName);
+    vector< stl::Data<float> > changedObjs = objs;
+    changedObjs[0].mPositions[0] = meshio::Vec4<float>(2, 2, 2, 1);
+    stl::write(fileName, stl::Format::Ascii, changedObjs);
+    ASSERT_EQ(fs::file_size(fileName), size);
+    fs::last_write_time(fileName, mtime);
+
+    stl::read<float>(cachedObjs, fileName, options);
+    EXPECT_TRUE(cachedObjs[0] == objs[0]);
+
+    options.mVerifyCacheContent = true;
+    stl::read<float>(cachedObjs, fileName, options);
+    EXPECT_TRUE(cachedObjs[0] == changedObjs[0]);
+}
+
+/* Triangles along the x axis, stored in shuffled order */
+static stl::Data<float> shuffledStrip(unsigned pNumTriangles)
+{
+    stl::Data<float> obj;
+    obj.resize(pNumTriangles);
+    for (unsigned i = 0; i < pNumTriangles; ++i) {
+        const float x = static_cast<float>(i);
+        obj.mNormals[i] = meshio::Vec3<float>(x, 0, 1);
+        obj.mPositions[3 * i + 0] = meshio::Vec4<float>(x, 0, 0, 1);
+        obj.mPositions[3 * i + 1] = meshio::Vec4<float>(x + 1, 0, 0, 1);
+        obj.mPositions[3 * i + 2] = meshio::Vec4<float>(x, 1, 0, 1);
+    }
+    shuffleTriangles(obj);
+    return obj;
+}
+
+TEST(STL, SPATIAL_SORT_MORTON)
+{
+    const unsigned numTriangles = 100000;
+
+    stl::Data<float> obj = shuffledStrip(numTriangles);
+    stl::spatialSort(obj, stl::SpatialOrder::Morton);
+
+    /* Along a single axis Morton order is plain coordinate order */
+    ASSERT_EQ(obj.mNormals.size(), numTriangles);
+    ASSERT_EQ(obj.mPositions.size(), 3 * numTriangles);
+    for (unsigned i = 0; i < numTriangles; ++i) {
+        const float x = static_cast<float>(i);
+        EXPECT_EQ(obj.mNormals[i].x, x);
+        EXPECT_EQ(obj.mPositions[3 * i + 0].x, x);
+        EXPECT_EQ(obj.mPositions[3 * i + 1].x, x + 1);
+        EXPECT_EQ(obj.mPositions[3 * i + 2].y, 1);
+    }
+}
+
+TEST(STL, SPATIAL_SORT_HILBERT)
+{
+    const unsigned numTriangles = 100000;
+
+    stl::Data<float> obj = shuffledStrip(numTriangles);
+    stl::spatialSort(obj, stl::SpatialOrder::Hilbert);
+
+    ASSERT_EQ(obj.mNormals.size(), numTriangles);
+    ASSERT_EQ(obj.mPositions.size(), 3 * numTriangles);
+
+    vector<bool> seen(numTriangles, false);
+    for (unsigned i = 0; i < numTriangles; ++i) {
+        /* Normals travel with their triangle */
+        const float x = obj.mPositions[3 * i].x;
+        EXPECT_EQ(obj.mNormals[i].x, x);
+        EXPECT_EQ(obj.mPositions[3 * i + 1].x, x + 1);
+        seen[static_cast<unsigned>(x)] = true;
+    }
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), true), numTriangles);
+}
+
+TEST(STL, SPATIAL_SORT_HILBERT_ADJACENCY)
+{
+    /* One triangle per cell of a 64^3 grid, its normal holding the cell */
+    const unsigned side = 64;
+    const unsigned numTriangles = side * side * side;
+
+    stl::Data<float> obj;
+    obj.resize(numTriangles);
+    for (unsigned i = 0; i < numTriangles; ++i) {
+        const float x = static_cast<float>(i % side);
+        const float y = static_cast<float>((i / side) % side);
+        const float z = static_cast<float>(i / (side * side));
+        obj.mNormals[i] = meshio::Vec3<float>(x, y, z);
+        obj.mPositions[3 * i + 0] = meshio::Vec4<float>(x, y, z, 1);
+        obj.mPositions[3 * i + 1] = meshio::Vec4<float>(x + 1, y, z, 1);
+        obj.mPositions[3 * i + 2] = meshio::Vec4<float>(x, y + 1, z, 1);
+    }
+
+    /* Cells consecutive along the Hilbert curve share a face, which neither
+       Morton order nor a degenerate key gives. Several threads exercise the
+       merge of the sorted chunks, which must not change the result */
+    stl::Data<float> reference;
+    for (unsigned numThreads : {1u, 4u}) {
+        stl::Data<float> sorted = obj;
+        stl::spatialSort(sorted, stl::SpatialOrder::Hilbert, numThreads);
+        ASSERT_EQ(sorted.mNormals.size(), numTriangles);
+
+        for (unsigned i = 1; i < numTriangles; ++i) {
+            const meshio::Vec3<float>& a = sorted.mNormals[i - 1];
+            const meshio::Vec3<float>& b = sorted.mNormals[i];
+            const float steps = std::fabs(a.x - b.x) + std::fabs(a.y - b.y) +
+                                std::fabs(a.z - b.z);
+            ASSERT_EQ(steps, 1.0f) << "cells " << i - 1 << " and " << i;
+            ASSERT_EQ(sorted.mPositions[3 * i].x, b.x);
+        }
+
+        if (numThreads == 1)
+            reference = sorted;
+        else
+            EXPECT_TRUE(sorted == reference);
+    }
+}
+
+TEST(STL, READ_WRITE_SPATIAL_ORDER)
+{
+    vector< stl::Data<float> > objs;
+    stl::read<float>(objs, TEST_DIR "/cube_ascii.stl");
+
+    stl::WriteOptions writeOptions;
+    writeOptions.mSpatialOrder = stl::SpatialOrder::Hilbert;
+    stl::write(TEST_OUTPUT_DIR "/cube_hilbert.stl", stl::Format::Binary, objs,
+               writeOptions);
+
+    stl::ReadOptions readOptions;
+    readOptions.mSpatialOrder = stl::SpatialOrder::Hilbert;
+    vector< stl::Data<float> > sortedObjs;
+    stl::read<float>(sortedObjs, TEST_DIR "/cube_ascii.stl", readOptions);
+
+    vector< stl::Data<float> > writtenObjs;
+    stl::read<float>(writtenObjs, TEST_OUTPUT_DIR "/cube_hilbert.stl");
+
+    EXPECT_TRUE(sortedObjs[0] == writtenObjs[0]);
+    EXPECT_FALSE(sortedObjs[0] == objs[0]);
+}
+
+/* Triangulated pNumCells x pNumCells grid, triangles in shuffled order */
+static stl::Data<float> shuffledGrid(unsigned pNumCells)
+{
+    const unsigned numTriangles = 2 * pNumCells * pNumCells;
+
+    stl::Data<float> obj;
+    obj.resize(numTriangles);
+    for (unsigned i = 0; i < numTriangles; ++i) {
+        const float x = static_cast<float>((i / 2) % pNumCells);
+        const float y = static_cast<float>((i / 2) / pNumCells);
+        obj.mNormals[i] = meshio::Vec3<float>(0, 0, 1);
+        if (i % 2) {
+            obj.mPositions[3 * i + 0] = meshio::Vec4<float>(x, y, 0, 1);
+            obj.mPositions[3 * i + 1] = meshio::Vec4<float>(x + 1, y, 0, 1);
+            obj.mPositions[3 * i + 2] = meshio::Vec4<float>(x + 1, y + 1, 0, 1);
+        } else {
+            obj.mPositions[3 * i + 0] = meshio::Vec4<float>(x, y, 0, 1);
+            obj.mPositions[3 * i + 1] = meshio::Vec4<float>(x + 1, y + 1, 0, 1);
+            obj.mPositions[3 * i + 2] = meshio::Vec4<float>(x, y + 1, 0, 1);
+        }
+    }
+    shuffleTriangles(obj);
+    return obj;
+}
+
+TEST(STL, MAKE_INDEXED)
+{
+    vector< stl::Data<float> > objs;
+    stl::read<float>(objs, TEST_DIR "/cube_binary.stl");
+
+    stl::IndexedData<float> indexed;
+    stl::makeIndexed(objs[0], indexed);
+
+    EXPECT_EQ(indexed.mPositions.size(), 8u);
+    ASSERT_EQ(indexed.mIndices.size(), objs[0].mPositions.size());
+    EXPECT_EQ(indexed.mNormals.size(), objs[0].mNormals.size());
+    for (size_t i = 0; i < indexed.mIndices.size(); ++i)
+        EXPECT_TRUE(indexed.mPositions[indexed.mIndices[i]] ==
+                    objs[0].mPositions[i]);
+}
+
+TEST(STL, MAKE_INDEXED_SIGNED_ZERO)
+{
+    stl::Data<float> obj;
+    obj.resize(2);
+    obj.mPositions[0] = meshio::Vec4<float>(0.0f, 0.0f, 0.0f, 1);
+    obj.mPositions[1] = meshio::Vec4<float>(1.0f, 0.0f, 0.0f, 1);
+    obj.mPositions[2] = meshio::Vec4<float>(0.0f, 1.0f, 0.0f, 1);
+    obj.mPositions[3] = meshio::Vec4<float>(-0.0f, 0.0f, -0.0f, 1);
+    obj.mPositions[4] = meshio::Vec4<float>(0.0f, -1.0f, 0.0f, 1);
+    obj.mPositions[5] = meshio::Vec4<float>(1.0f, -0.0f, 0.0f, 1);
+
+    stl::IndexedData<float> indexed;
+    stl::makeIndexed(obj, indexed);
+
+    EXPECT_EQ(indexed.mPositions.size(), 4u);
+    ASSERT_EQ(indexed.mIndices.size(), 6u);
+    EXPECT_EQ(indexed.mIndices[3], indexed.mIndices[0]);
+    EXPECT_EQ(indexed.mIndices[5], indexed.mIndices[1]);
+}
+
+TEST(STL, OPTIMIZE_VERTEX_CACHE)
+{
+    const unsigned numCells = 200;
+
+    stl::Data<float> obj = shuffledGrid(numCells);
+    stl::IndexedData<float> indexed;
+    stl::makeIndexed(obj, indexed);
+    EXPECT_EQ(indexed.mPositions.size(), (numCells + 1) * (numCells + 1));
+
+    const stl::VertexCacheStats stats = stl::optimizeVertexCache(indexed);
+
+    EXPECT_GT(stats.mAcmrBefore, 2.5f);
+    EXPECT_LT(stats.mAcmrAfter, 0.8f);
+    EXPECT_FLOAT_EQ(stats.mAcmrAfter,
+                    stl::acmr(indexed.mIndices, indexed.mPositions.size()));
+
+    /* Every triangle is emitted exactly once and vertices are numbered in
+       order of first use */
+    ASSERT_EQ(indexed.mIndices.size(), obj.mPositions.size());
+    ASSERT_EQ(indexed.mNormals.size(), obj.mNormals.size());
+    vector<unsigned> triangleCount(obj.mNormals.size(), 0);
+    uint32_t nextVertex = 0;
+    for (size_t t = 0; t < indexed.mNormals.size(); ++t) {
+        const meshio::Vec4<float>& a = indexed.mPositions[indexed.mIndices[3 * t]];
+        const meshio::Vec4<float>& c = indexed.mPositions[indexed.mIndices[3 * t + 2]];
+        const unsigned cell = static_cast<unsigned>(a.y) * numCells +
+                              static_cast<unsigned>(a.x);
+        triangleCount[2 * cell + (c.x > a.x ? 1 : 0)]++;
+
+        for (int i = 0; i < 3; ++i) {
+            EXPECT_LE(indexed.mIndices[3 * t + i], nextVertex);
+            if (indexed.mIndices[3 * t + i] == nextVertex)
+                ++nextVertex;
+        }
+    }
+    for (unsigned count : triangleCount)
+        EXPECT_EQ(count, 1u);
+}
+
+TEST(STL, OPTIMIZE_VERTEX_CACHE_INVALID)
+{
+    stl::Data<float> obj = shuffledGrid(4);
+    stl::IndexedData<float> indexed;
+    stl::makeIndexed(obj, indexed);
+
+    /* An index past mPositions must leave the mesh untouched */
+    indexed.mIndices[7] = static_cast<uint32_t>(indexed.mPositions.size());
+    const stl::IndexedData<float> original = indexed;
+
+    const stl::VertexCacheStats stats = stl::optimizeVertexCache(indexed);
+    EXPECT_EQ(stats.mAcmrBefore, 0.0f);
+    EXPECT_EQ(stats.mAcmrAfter, 0.0f);
+    EXPECT_EQ(stats.mClusters, 0u);
+    EXPECT_TRUE(indexed.mIndices == original.mIndices);
+    EXPECT_EQ(indexed.mPositions.size(), original.mPositions.size());
+
+    EXPECT_GT(stl::acmr(indexed.mIndices, indexed.mPositions.size()), 0.0f);
+}
+
+/* Latitude-longitude sphere of pRadius around the origin, wound outwards,
+   with its triangles in shuffled order */
+static void appendSphere(stl::Data<float>& pObj, const float pRadius)
+{
+    const unsigned rings = 24, segments = 48;
+    const double pi = 3.14159265358979323846;
+
+    auto vertex = [&](unsigned pRing, unsigned pSegment) {
+        const double theta = pi * pRing / rings;
+        const double phi = 2.0 * pi * (pSegment % segments) / segments;
+        return meshio::Vec4<float>(
+            float(pRadius * std::sin(theta) * std::cos(phi)),
+            float(pRadius * std::sin(theta) * std::sin(phi)),
+            float(pRadius * std::cos(theta)), 1);
+    };
+
+    stl::Data<float> sphere;
+    for (unsigned r = 0; r < rings; ++r) {
+        for (unsigned s = 0; s < segments; ++s) {
+            const meshio::Vec4<float> a = vertex(r, s),     b = vertex(r + 1, s);
+            const meshio::Vec4<float> c = vertex(r + 1, s + 1);
+            const meshio::Vec4<float> d = vertex(r, s + 1);
+            if (r > 0) {
+                sphere.mPositions.insert(sphere.mPositions.end(), {a, b, d});
+                sphere.mNormals.push_back(meshio::Vec3<float>());
+            }
+            if (r + 1 < rings) {
+                sphere.mPositions.insert(sphere.mPositions.end(), {d, b, c});
+                sphere.mNormals.push_back(meshio::Vec3<float>());
+            }
+        }
+    }
+    shuffleTriangles(sphere);
+
+    pObj.mNormals.insert(pObj.mNormals.end(), sphere.mNormals.begin(),
+                         sphere.mNormals.end());
+    pObj.mPositions.insert(pObj.mPositions.end(), sphere.mPositions.begin(),
+                           sphere.mPositions.end());
+}
+
+TEST(STL, OPTIMIZE_OVERDRAW)
+{
+    /* An outer sphere around an inner one: all of the outer shell must be
+       drawn before the inner shell it hides */
+    stl::Data<float> obj;
+    appendSphere(obj, 4.0f);
+    const size_t numOuter = obj.mNormals.size();
+    appendSphere(obj, 1.0f);
+
+    stl::IndexedData<float> indexed;
+    stl::makeIndexed(obj, indexed);
+    stl::IndexedData<float> cacheOnly = indexed;
+
+    const stl::VertexCacheStats stats = stl::optimizeVertexCache(indexed);
+    const stl::VertexCacheStats cacheStats =
+        stl::optimizeVertexCache(cacheOnly, 16, 0.0f);
+
+    EXPECT_GT(stats.mClusters, cacheStats.mClusters);
+    EXPECT_LT(stats.mAcmrAfter, 1.0f);
+    EXPECT_LE(cacheStats.mAcmrAfter, stats.mAcmrAfter);
+
+    ASSERT_EQ(indexed.mIndices.size(), obj.mPositions.size());
+    for (size_t t = 0; t < indexed.mNormals.size(); ++t) {
+        const meshio::Vec4<float>& a = indexed.mPositions[indexed.mIndices[3 * t]];
+        const float radius = std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+        EXPECT_EQ(radius > 2.0f, t < numOuter) << "triangle " << t;
+    }
+}
+
+template<typename N>
+static void checkQuantized(const stl::Data<float>& pReference,
+                           const stl::QuantizedData<N>& pQuantized,
+                           const float pMaxNormalDegrees)
+{
+    ASSERT_EQ(pQuantized.mPositions.size(), pReference.mPositions.size());
+    ASSERT_EQ(pQuantized.mNormals.size(), pReference.mNormals.size());
+
+    vector< meshio::Vec4<float> > positions(pQuantized.mPositions.size());
+    pQuantized.positions(0, positions.size(), positions.data());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        const meshio::Vec4<float> p = pQuantized.position(i);
+        EXPECT_FLOAT_EQ(positions[i].x, p.x);
+        EXPECT_FLOAT_EQ(positions[i].y, p.y);
+        EXPECT_FLOAT_EQ(positions[i].z, p.z);
+        EXPECT_EQ(positions[i].w, 1.0f);
+
+        const meshio::Vec4<float>& r = pReference.mPositions[i];
+        EXPECT_LE(std::fabs(p.x - r.x), 0.5f * pQuantized.mStep.x + 1e-6f);
+        EXPECT_LE(std::fabs(p.y - r.y), 0.5f * pQuantized.mStep.y + 1e-6f);
+        EXPECT_LE(std::fabs(p.z - r.z), 0.5f * pQuantized.mStep.z + 1e-6f);
+    }
+
+    /* Batched decoding matches the per element accessors, also for ranges
+       that do not start or end on a multiple of the SIMD width */
+    if (positions.size() > 2) {
+        const size_t count = positions.size() - 2;
+        vector< meshio::Vec4<float> > range(count);
+        pQuantized.positions(1, count, range.data());
+        for (size_t i = 0; i < count; ++i) {
+            EXPECT_FLOAT_EQ(range[i].x, positions[i + 1].x);
+            EXPECT_FLOAT_EQ(range[i].y, positions[i + 1].y);
+            EXPECT_FLOAT_EQ(range[i].z, positions[i + 1].z);
+            EXPECT_EQ(range[i].w, 1.0f);
+        }
+    }
+
+    vector< meshio::Vec3<float> > normals(pQuantized.mNormals.size());
+    pQuantized.normals(0, normals.size(), normals.data());
+    for (size_t i = 0; i < normals.size(); ++i) {
+        const meshio::Vec3<float> decoded = pQuantized.normal(i);
+        EXPECT_FLOAT_EQ(normals[i].x, decoded.x);
+        EXPECT_FLOAT_EQ(normals[i].y, decoded.y);
+        EXPECT_FLOAT_EQ(normals[i].z, decoded.z);
+    }
+    if (normals.size() > 1) {
+        vector< meshio::Vec3<float> > range(normals.size() - 1);
+        pQuantized.normals(1, range.size(), range.data());
+        for (size_t i = 0; i < range.size(); ++i)
+            EXPECT_TRUE(range[i] == normals[i + 1]);
+    }
+
+    for (size_t i = 0; i < normals.size(); ++i) {
+        const meshio::Vec3<double> n(normals[i].x, normals[i].y, normals[i].z);
+        const meshio::Vec3<double> r(pReference.mNormals[i].x,
+                                     pReference.mNormals[i].y,
+                                     pReference.mNormals[i].z);
+        const meshio::Vec3<double> c = meshio::cross(n, r);
+        const double degrees =
+            std::atan2(std::sqrt(c.x * c.x + c.y * c.y + c.z * c.z),
+                       n.x * r.x + n.y * r.y + n.z * r.z) * 180.0 / M_PI;
+        EXPECT_LE(degrees, pMaxNormalDegrees);
+    }
+}
+
+TEST(STL, READ_QUANTIZED)
+{
+    vector< stl::Data<float> > referenceObjs;
+    initializeReferenceSTLObj(referenceObjs);
+
+    vector< stl::QuantizedData<uint16_t> > binaryObjs;
+    EXPECT_TRUE(stl::read(binaryObjs, TEST_DIR "/cube_binary.stl"));
+    ASSERT_EQ(binaryObjs.size(), 1u);
+    checkQuantized(referenceObjs[0], binaryObjs[0], 0.64f);
+
+    vector< stl::QuantizedData<uint32_t> > asciiObjs;
+    EXPECT_TRUE(stl::read(asciiObjs, TEST_DIR "/cube_ascii.stl"));
+    ASSERT_EQ(asciiObjs.size(), 1u);
+    checkQuantized(referenceObjs[0], asciiObjs[0], 0.008f);
+
+    vector< stl::QuantizedData<uint16_t> > invalidObjs;
+    EXPECT_FALSE(stl::read(invalidObjs, "/home/nonexistant/cube.stl"));
+}
+
+TEST(STL, QUANTIZE)
+{
+    /* Irregular coordinates, so quantization actually rounds */
+    stl::Data<float> obj = shuffledGrid(50);
+    for (size_t i = 0; i < obj.mPositions.size(); ++i) {
+        meshio::Vec4<float>& p = obj.mPositions[i];
+        p.z = std::sin(0.37f * p.x) * std::cos(0.11f * p.y);
+        p.x *= 0.731f;
+    }
+    for (size_t i = 0; i < obj.mNormals.size(); ++i) {
+        const float a = 0.013f * i, b = 0.007f * i;
+        obj.mNormals[i] = meshio::Vec3<float>(std::cos(a) * std::sin(b),
+                                              std::sin(a) * std::sin(b),
+                                              std::cos(b));
+    }
+
+    stl::QuantizedData<uint16_t> quantized16;
+    stl::quantize(obj, quantized16);
+    checkQuantized(obj, quantized16, 0.64f);
+
+    stl::QuantizedData<uint32_t> quantized32;
+    stl::quantize(obj, quantized32);
+    checkQuantized(obj, quantized32, 0.008f);
+
+    /* Streaming binary reader matches quantizing in memory */
+    vector< stl::Data<float> > objs(1, obj);
+    stl::write(TEST_OUTPUT_DIR "/grid_binary.stl", stl::Format::Binary, objs);
+    vector< stl::QuantizedData<uint16_t> > readObjs;
+    stl::read(readObjs, TEST_OUTPUT_DIR "/grid_binary.stl");
+    ASSERT_EQ(readObjs.size(), 1u);
+    for (size_t i = 0; i < obj.mPositions.size(); ++i)
+        EXPECT_TRUE(readObjs[0].mPositions[i] == quantized16.mPositions[i]);
+    EXPECT_TRUE(readObjs[0].mNormals == quantized16.mNormals);
+
+    /* So does the streaming ASCII reader, across blocks and solids */
+    vector< stl::Data<float> > cubeObjs;
+    initializeReferenceSTLObj(cubeObjs);
+    objs.push_back(cubeObjs[0]);
+    stl::write(TEST_OUTPUT_DIR "/grid_ascii.stl", stl::Format::Ascii, objs);
+
+    vector< stl::Data<float> > parsedObjs;
+    stl::read<float>(parsedObjs, TEST_OUTPUT_DIR "/grid_ascii.stl");
+    vector< stl::QuantizedData<uint32_t> > asciiObjs;
+    EXPECT_TRUE(stl::read(asciiObjs, TEST_OUTPUT_DIR "/grid_ascii.stl"));
+    ASSERT_EQ(parsedObjs.size(), 2u);
+    ASSERT_EQ(asciiObjs.size(), 2u);
+    for (size_t o = 0; o < asciiObjs.size(); ++o) {
+        stl::QuantizedData<uint32_t> expected;
+        stl::quantize(parsedObjs[o], expected);
+        EXPECT_TRUE(asciiObjs[o].mOrigin == expected.mOrigin);
+        EXPECT_TRUE(asciiObjs[o].mStep == expected.mStep);
+        ASSERT_EQ(asciiObjs[o].mPositions.size(), expected.mPositions.size());
+        for (size_t i = 0; i < expected.mPositions.size(); ++i)
+            EXPECT_TRUE(asciiObjs[o].mPositions[i] == expected.mPositions[i]);
+        EXPECT_TRUE(asciiObjs[o].mNormals == expected.mNormals);
+    }
+}
+
+#ifdef MESHIO_CONVERT
+static int runConvert(const std::string& pArguments)
+{
+    const std::string command = "\"" MESHIO_CONVERT "\" -q " + pArguments;
+    return std::system(command.c_str());
+}
+
+TEST(STL, CONVERT_EMPTY_SOLID)
+{
+    vector< stl::Data<float> > referenceObjs;
+    initializeReferenceSTLObj(referenceObjs);
+
+    /* An empty solid ahead of the cube must not end the binary object list */
+    const std::string input = TEST_OUTPUT_DIR "/convert_empty_solid.stl";
+    {
+        std::ifstream cube(TEST_DIR "/cube_ascii.stl");
+        std::ofstream ofs(input);
+        ofs << "solid empty\nendsolid empty\n" << cube.rdbuf();
+    }
+
+    const std::string binary = TEST_OUTPUT_DIR "/convert_empty_solid.bin.stl";
+    ASSERT_EQ(runConvert("-t binary -o \"" + binary + "\" \"" + input + "\""),
+              0);
+    vector< stl::Data<float> > objs;
+    EXPECT_TRUE(stl::read<float>(objs, binary.c_str()));
+    ASSERT_EQ(objs.size(), 1u);
+    EXPECT_TRUE(objs[0] == referenceObjs[0]);
+
+    const std::string ascii = TEST_OUTPUT_DIR "/convert_empty_solid.txt.stl";
+    ASSERT_EQ(runConvert("-t ascii -o \"" + ascii + "\" \"" + binary + "\""),
+              0);
+    objs.clear();
+    EXPECT_TRUE(stl::read<float>(objs, ascii.c_str()));
+    ASSERT_EQ(objs.size(), 1u);
+    EXPECT_TRUE(objs[0] == referenceObjs[0]);
+}
+
+TEST(STL, CONVERT_INTO_DIRECTORY)
+{
+    namespace fs = std::filesystem;
+
+    /* An existing directory given to -o receives the single input by name */
+    const fs::path outDir = fs::path(TEST_OUTPUT_DIR) / "convert_dir";
+    fs::remove_all(outDir);
+    fs::create_directories(outDir);
+
+    ASSERT_EQ(runConvert("-t binary -o \"" + outDir.string() + "/\" \""
+                         TEST_DIR "/cube_ascii.stl\""), 0);
+
+    const fs::path output = outDir / "cube_ascii.stl";
+    vector< stl::Data<float> > objs;
+    EXPECT_TRUE(stl::read<float>(objs, output.string().c_str()));
+    ASSERT_EQ(objs.size(), 1u);
+
+    vector< stl::Data<float> > referenceObjs;
+    initializeReferenceSTLObj(referenceObjs);
+    EXPECT_TRUE(objs[0] == referenceObjs[0]);
+}
+#endif